@@ -19,6 +19,27 @@
 #include <errno.h>
 #include <windows.h>
 #endif
+#if HAVE_MMAP && HAVE_SYS_MMAN_H
+#include <sys/mman.h>
+#include <signal.h>
+#if !defined(MAP_ANONYMOUS) && defined(MAP_ANON)
+#define MAP_ANONYMOUS MAP_ANON
+#endif
+#endif
+/*
+ * A mapped file that is truncated raises SIGBUS when the lost pages
+ * are touched, so we only map files if we can catch that.
+ */
+#if HAVE_MMAP && HAVE_SYS_MMAN_H && defined(SA_SIGINFO) && defined(MAP_ANONYMOUS) && defined(MAP_FIXED)
+#define CH_MMAP 1
+#else
+#define CH_MMAP 0
+#endif
+#if HAVE_POSIX_FADVISE && defined(POSIX_FADV_WILLNEED)
+#define CH_READAHEAD 1
+#else
+#define CH_READAHEAD 0
+#endif
 
 typedef POSITION BLOCKNUM;
 
@@ -35,12 +56,20 @@ struct bufnode {
 	struct bufnode *hnext, *hprev;
 };
 
+/*
+ * Each file has its own block size, chosen when the file is first opened.
+ * LBUFSIZE is the default, and is always used for pipes.
+ * The data for a block immediately follows its struct buf.
+ */
 #define LBUFSIZE        8192
+#define MAX_LBUFSIZE    (1024*1024)
+#define UNLIM_LBUFSIZE  (256*1024)  /* Auto block size when -b is unlimited */
+#define MIN_AUTO_NBUFS  8           /* Auto block size fits this many in -b */
 struct buf {
 	struct bufnode node;
 	BLOCKNUM block;
 	size_t datasize;
-	unsigned char data[LBUFSIZE];
+	unsigned char *data;
 };
 #define bufnode_buf(bn)  ((struct buf *) bn)
 
@@ -59,6 +88,18 @@ struct filestate {
 	BLOCKNUM block;
 	size_t offset;
 	POSITION fsize;
+	size_t blksize;
+	int maxbufs;
+#if CH_READAHEAD
+	BLOCKNUM lastmiss;        /* Block of most recent buffer miss */
+	int nseq;                 /* Number of consecutive sequential misses */
+	POSITION rapos;           /* End of region requested by read-ahead */
+	int advice;               /* Access pattern last given to posix_fadvise */
+#endif
+#if CH_MMAP
+	unsigned char *mapbase;   /* Mapping of start of file, or NULL */
+	size_t mapsize;           /* Number of bytes mapped */
+#endif
 };
 
 #define ch_bufhead      thisfile->buflist.next
@@ -70,6 +111,8 @@ struct filestate {
 #define ch_fsize        thisfile->fsize
 #define ch_flags        thisfile->flags
 #define ch_file         thisfile->file
+#define ch_blksize      thisfile->blksize
+#define ch_maxbufs      thisfile->maxbufs
 
 #define END_OF_CHAIN    (&thisfile->buflist)
 #define END_OF_HCHAIN(h) (&thisfile->hashtbl[h])
@@ -117,9 +160,11 @@ struct filestate {
 static struct filestate *thisfile;
 static unsigned char ch_ungotchar;
 static lbool ch_have_ungotchar = FALSE;
-static int maxbufs = -1;
+static ssize_t maxbufspace = -1;
 
 extern int autobuf;
+extern int use_mmap;
+extern int block_size;
 extern int sigs;
 extern int follow_mode;
 extern lbool waiting_for_data;
@@ -132,13 +177,18 @@ extern char *namelogfile;
 #endif
 
 static int ch_addbuf();
+static void ch_readahead(void);
+static void ch_remap(void);
+#if CH_MMAP
+static volatile sig_atomic_t map_fault = 0;
+#endif
 
 /*
  * Return the file position corresponding to an offset within a block.
  */
 static POSITION ch_position(BLOCKNUM block, size_t offset)
 {
-	return (block * LBUFSIZE) + (POSITION) offset;
+	return (block * (POSITION) ch_blksize) + (POSITION) offset;
 }
 
 /*
@@ -154,6 +204,39 @@ static int ch_get(void)
 	if (thisfile == NULL)
 		return (EOI);
 
+#if CH_MMAP
+	/*
+	 * If the file is mapped, get the char directly from the mapping.
+	 * Anything past the end of the mapping (data appended since 
+	 * the file was mapped) is read into buffers as usual.
+	 */
+	if (thisfile->mapbase != NULL)
+	{
+		POSITION pos = ch_position(ch_block, ch_offset);
+		if (pos < (POSITION) thisfile->mapsize)
+		{
+			int c = thisfile->mapbase[pos];
+			if (!map_fault)
+				return (c);
+		}
+		if (map_fault)
+		{
+			/*
+			 * The file was truncated while mapped.
+			 * Map what is left, forget any lines made from
+			 * the zeros we read, and repaint.
+			 */
+			POSITION fsize = filesize(ch_file);
+			map_fault = 0;
+			if (fsize != NULL_POSITION)
+				ch_fsize = fsize;
+			ch_remap();
+			clr_line_cache();
+			screen_trashed();
+		}
+	}
+#endif
+
 	/*
 	 * Quick check for the common case where 
 	 * the desired char is in the head buffer.
@@ -187,6 +270,7 @@ static int ch_get(void)
 		return (EOI);
 	if (bn == END_OF_HCHAIN(h))
 	{
+		ch_readahead();
 		/*
 		 * Block is not in a buffer.  
 		 * Take the least recently used buffer 
@@ -204,7 +288,7 @@ static int ch_get(void)
 			 * 2. We haven't allocated the max buffers for this file yet.
 			 */
 			if ((autobuf && !(ch_flags & CH_CANSEEK)) ||
-				(maxbufs < 0 || ch_nbufs < maxbufs))
+				(ch_maxbufs < 0 || ch_nbufs < ch_maxbufs))
 				if (ch_addbuf())
 					/*
 					 * Allocation failed: turn off autobuf.
@@ -278,7 +362,7 @@ static int ch_get(void)
 			n = 1;
 		} else
 		{
-			n = iread(ch_file, &bp->data[bp->datasize], LBUFSIZE - bp->datasize);
+			n = iread(ch_file, &bp->data[bp->datasize], ch_blksize - bp->datasize);
 		}
 
 		read_again = FALSE;
@@ -435,7 +519,7 @@ public void sync_logfile(void)
 
 	if (logfile < 0)
 		return;
-	nblocks = (ch_fpos + LBUFSIZE - 1) / LBUFSIZE;
+	nblocks = (ch_fpos + (POSITION) ch_blksize - 1) / (POSITION) ch_blksize;
 	for (block = 0;  block < nblocks;  block++)
 	{
 		lbool wrote = FALSE;
@@ -496,7 +580,7 @@ public int ch_seek(POSITION pos)
 	if (pos < ch_zero() || (len != NULL_POSITION && pos > len))
 		return (1);
 
-	new_block = pos / LBUFSIZE;
+	new_block = pos / (POSITION) ch_blksize;
 	if (!(ch_flags & CH_CANSEEK) && pos != ch_fpos && !buffered(new_block))
 	{
 		if (ch_fpos > pos)
@@ -514,7 +598,7 @@ public int ch_seek(POSITION pos)
 	 * Set read pointer.
 	 */
 	ch_block = new_block;
-	ch_offset = (size_t) (pos % LBUFSIZE);
+	ch_offset = (size_t) (pos % (POSITION) ch_blksize);
 	return (0);
 }
 
@@ -630,6 +714,206 @@ public void ch_resize(void)
 	fsize = filesize(ch_file);
 	if (fsize != NULL_POSITION)
 		ch_fsize = fsize;
+#if CH_MMAP
+	if (thisfile->mapbase != NULL && ch_fsize != (POSITION) thisfile->mapsize)
+		ch_remap();
+#endif
+}
+
+/*
+ * Unmap the current file, if it is mapped.
+ */
+static void ch_unmap(void)
+{
+#if CH_MMAP
+	if (thisfile->mapbase != NULL)
+	{
+		munmap((void *) thisfile->mapbase, thisfile->mapsize);
+		thisfile->mapbase = NULL;
+		thisfile->mapsize = 0;
+	}
+#endif
+}
+
+#if CH_MMAP
+/*
+ * Handle SIGBUS raised by touching a page of the mapping which is
+ * past the end of the file (the file was truncated after we mapped it).
+ * Cover the page with zeros so the access can complete, and
+ * let ch_get drop the mapping on its next call.
+ */
+static void ch_sigbus(int sig, siginfo_t *info, void *context)
+{
+	char *base = (thisfile == NULL) ? NULL : (char *) thisfile->mapbase;
+	char *addr = (char *) info->si_addr;
+	size_t pgsize = (size_t) sysconf(_SC_PAGESIZE);
+
+	(void) context;
+	if (base == NULL || addr < base || addr >= base + thisfile->mapsize ||
+	    mmap(addr - (size_t) (addr - base) % pgsize, pgsize, PROT_READ,
+	         MAP_PRIVATE|MAP_ANONYMOUS|MAP_FIXED, -1, 0) == MAP_FAILED)
+	{
+		/* Not ours, or we can't fix it: fault again and die. */
+		signal(sig, SIG_DFL);
+		return;
+	}
+	map_fault = 1;
+}
+
+/*
+ * Install the SIGBUS handler, the first time a file is mapped.
+ */
+static lbool ch_catch_sigbus(void)
+{
+	static lbool caught = FALSE;
+	struct sigaction sa;
+
+	if (caught)
+		return (TRUE);
+	memset(&sa, 0, sizeof(sa));
+	sigemptyset(&sa.sa_mask);
+	sa.sa_sigaction = ch_sigbus;
+	sa.sa_flags = SA_SIGINFO;
+	if (sigaction(SIGBUS, &sa, NULL) < 0)
+		return (FALSE);
+	caught = TRUE;
+	return (TRUE);
+}
+#endif
+
+/*
+ * Map the current file into memory, if that is enabled and possible.
+ * Only regular seekable files are mapped; if the mapping fails,
+ * we quietly fall back to reading the file into buffers.
+ */
+static void ch_remap(void)
+{
+#if CH_MMAP
+	void *addr;
+
+	ch_unmap();
+	if (!use_mmap || ch_file < 0)
+		return;
+	if ((ch_flags & (CH_CANSEEK|CH_HELPFILE|CH_POPENED|CH_NODATA|CH_NOTRUSTSIZE)) != CH_CANSEEK)
+		return;
+	if (ch_fsize == NULL_POSITION || ch_fsize <= 0 || (POSITION) (size_t) ch_fsize != ch_fsize)
+		return;
+	if (!ch_catch_sigbus())
+		return;
+	addr = mmap(NULL, (size_t) ch_fsize, PROT_READ, MAP_SHARED, ch_file, 0);
+	if (addr == MAP_FAILED)
+		return;
+	thisfile->mapbase = (unsigned char *) addr;
+	thisfile->mapsize = (size_t) ch_fsize;
+	got_data(TRUE);
+#endif
+}
+
+#if CH_READAHEAD
+/*
+ * Amount of data to request ahead of the reader
+ * once a sequential scan has been detected.
+ */
+#define READAHEAD_SIZE  (2*1024*1024)
+#define READAHEAD_NSEQ  2   /* Sequential misses before read-ahead starts */
+
+/*
+ * Give the kernel advice about how we are going to read the file.
+ * A len of 0 means to the end of the file.
+ */
+static void ch_advise(POSITION pos, POSITION len, int advice)
+{
+	(void) posix_fadvise(ch_file, (less_off_t) pos, (less_off_t) len, advice);
+}
+
+/*
+ * Set the access pattern for the whole file, if it has changed.
+ */
+static void ch_pattern(int advice)
+{
+	if (thisfile->advice == advice)
+		return;
+	ch_advise(0, 0, advice);
+	thisfile->advice = advice;
+}
+#endif
+
+/*
+ * Called on each buffer miss in a seekable file.
+ * If the misses are walking forward through the file (as in a search
+ * or a scan to end of file), ask the kernel to start reading the data
+ * beyond the current block, so that the I/O overlaps with our
+ * processing of the data we already have.
+ * If they are walking backward (as in a backward search or scroll),
+ * the kernel's own read-ahead, which only reads forward, is useless,
+ * so turn it off and instead request the data preceding the current
+ * block in large batches.
+ * The requests are asynchronous, so nothing needs to be cancelled
+ * if the scan is interrupted.
+ */
+static void ch_readahead(void)
+{
+#if CH_READAHEAD
+	POSITION pos;
+	POSITION window;
+
+	if ((ch_flags & (CH_CANSEEK|CH_HELPFILE)) != CH_CANSEEK || ch_file < 0)
+		return;
+	if (ch_block == thisfile->lastmiss + 1 && thisfile->nseq >= 0)
+		thisfile->nseq++;
+	else if (ch_block == thisfile->lastmiss - 1 && thisfile->nseq <= 0)
+		thisfile->nseq--;
+	else
+	{
+		/*
+		 * Not a sequential scan (or the scan changed direction):
+		 * undo any POSIX_FADV_RANDOM or POSIX_FADV_SEQUENTIAL
+		 * given for an earlier scan.
+		 */
+		thisfile->nseq = 0;
+		thisfile->rapos = NULL_POSITION;
+		ch_pattern(POSIX_FADV_NORMAL);
+	}
+	thisfile->lastmiss = ch_block;
+	if (thisfile->nseq < READAHEAD_NSEQ && thisfile->nseq > -READAHEAD_NSEQ)
+		return;
+
+	window = READAHEAD_SIZE;
+	if (window < 4 * (POSITION) ch_blksize)
+		window = 4 * (POSITION) ch_blksize;
+	if (thisfile->nseq > 0)
+	{
+		/* Forward: request the region following this block. */
+		pos = ch_position(ch_block + 1, 0);
+		if (thisfile->rapos != NULL_POSITION && thisfile->rapos - pos > window / 2)
+			/* Still well inside the region already requested. */
+			return;
+		if (thisfile->rapos == NULL_POSITION)
+			ch_pattern(POSIX_FADV_SEQUENTIAL);
+		else if (thisfile->rapos > pos)
+			pos = thisfile->rapos;
+		if (ch_fsize != NULL_POSITION && pos + window > ch_fsize)
+			window = ch_fsize - pos;
+		if (window > 0)
+			ch_advise(pos, window, POSIX_FADV_WILLNEED);
+		thisfile->rapos = pos + window;
+	} else
+	{
+		/* Backward: request the region preceding this block. */
+		pos = ch_position(ch_block, 0);
+		if (thisfile->rapos != NULL_POSITION && pos - thisfile->rapos > window / 2)
+			return;
+		if (thisfile->rapos == NULL_POSITION)
+			ch_pattern(POSIX_FADV_RANDOM);
+		else if (thisfile->rapos < pos)
+			pos = thisfile->rapos;
+		if (window > pos)
+			window = pos;
+		if (window > 0)
+			ch_advise(pos - window, window, POSIX_FADV_WILLNEED);
+		thisfile->rapos = pos - window;
+	}
+#endif
 }
 
 /*
@@ -654,7 +938,7 @@ public int ch_forw_get(void)
 	c = ch_get();
 	if (c == EOI)
 		return (EOI);
-	if (ch_offset < LBUFSIZE-1)
+	if (ch_offset < ch_blksize-1)
 		ch_offset++;
 	else
 	{
@@ -664,6 +948,69 @@ public int ch_forw_get(void)
 	return (c);
 }
 
+/*
+ * Get a run of chars starting at the read pointer, without moving it.
+ * Returns a pointer to the chars and sets *plen to the number of
+ * chars available there (at least 1), or returns NULL at EOI.
+ * The chars remain valid until the next call to any ch_ function.
+ * Use ch_forw_skip to move the read pointer past the chars consumed.
+ */
+public constant unsigned char * ch_forw_span(size_t *plen)
+{
+	static unsigned char cbuf;
+	struct buf *bp;
+	int c;
+
+	if (thisfile == NULL)
+		return (NULL);
+	c = ch_get();
+	if (c == EOI)
+		return (NULL);
+#if CH_MMAP
+	if (thisfile->mapbase != NULL)
+	{
+		POSITION pos = ch_position(ch_block, ch_offset);
+		if (pos < (POSITION) thisfile->mapsize)
+		{
+			*plen = thisfile->mapsize - (size_t) pos;
+			return (thisfile->mapbase + pos);
+		}
+	}
+#endif
+	/*
+	 * ch_get leaves the buffer it used at the head of the chain.
+	 */
+	bp = bufnode_buf(ch_bufhead);
+	if (ch_bufhead != END_OF_CHAIN && bp->block == ch_block && ch_offset < bp->datasize)
+	{
+		*plen = bp->datasize - ch_offset;
+		return (&bp->data[ch_offset]);
+	}
+	/* 
+	 * The char did not come from a buffer 
+	 * (e.g. lost data in a pipe): return just that char.
+	 */
+	cbuf = (unsigned char) c;
+	*plen = 1;
+	return (&cbuf);
+}
+
+/*
+ * Move the read pointer forward n chars.
+ * n must be no more than the length returned by the last ch_forw_span.
+ */
+public void ch_forw_skip(size_t n)
+{
+	if (thisfile == NULL)
+		return;
+	ch_offset += n;
+	if (ch_offset >= ch_blksize)
+	{
+		ch_block += (BLOCKNUM) (ch_offset / ch_blksize);
+		ch_offset %= ch_blksize;
+	}
+}
+
 /*
  * Pre-decrement the read pointer and get the new current char.
  */
@@ -680,28 +1027,63 @@ public int ch_back_get(void)
 		if (!(ch_flags & CH_CANSEEK) && !buffered(ch_block-1))
 			return (EOI);
 		ch_block--;
-		ch_offset = LBUFSIZE-1;
+		ch_offset = ch_blksize-1;
 	}
 	return (ch_get());
 }
 
 /*
- * Set max amount of buffer space.
- * bufspace is in units of 1024 bytes.  -1 mean no limit.
+ * Compute the max number of buffers for the current file.
  */
-public void ch_setbufspace(ssize_t bufspace)
+static void ch_calc_maxbufs(void)
 {
-	if (bufspace < 0)
-		maxbufs = -1;
+	if (maxbufspace < 0)
+		ch_maxbufs = -1;
 	else
 	{
-		size_t lbufk = LBUFSIZE / 1024;
-		maxbufs = (int) (bufspace / lbufk + (bufspace % lbufk != 0));
-		if (maxbufs < 1)
-			maxbufs = 1;
+		size_t lbufk = ch_blksize / 1024;
+		ch_maxbufs = (int) (maxbufspace / lbufk + (maxbufspace % lbufk != 0));
+		if (ch_maxbufs < 1)
+			ch_maxbufs = 1;
 	}
 }
 
+/*
+ * Set max amount of buffer space.
+ * bufspace is in units of 1024 bytes.  -1 mean no limit.
+ */
+public void ch_setbufspace(ssize_t bufspace)
+{
+	maxbufspace = bufspace;
+	if (thisfile != NULL)
+		ch_calc_maxbufs();
+}
+
+/*
+ * Choose the block size for a new file.
+ * If --block-size was not given, seekable files use the largest
+ * block size (up to MAX_LBUFSIZE) which still allows MIN_AUTO_NBUFS
+ * buffers to fit in the -b buffer space.  With the default -b this
+ * is LBUFSIZE; a larger -b gives fewer, larger reads.
+ * Pipes use LBUFSIZE, since their buffers are never discarded.
+ */
+static size_t ch_calc_blksize(int flags)
+{
+	size_t blksize;
+
+	if (block_size > 0)
+		return ((size_t) block_size * 1024);
+	if ((flags & (CH_CANSEEK|CH_HELPFILE)) != CH_CANSEEK)
+		return (LBUFSIZE);
+	if (maxbufspace < 0)
+		return (UNLIM_LBUFSIZE);
+	blksize = LBUFSIZE;
+	while (blksize < MAX_LBUFSIZE && 
+	       (ssize_t) (2 * blksize / 1024) * MIN_AUTO_NBUFS <= maxbufspace)
+		blksize *= 2;
+	return (blksize);
+}
+
 /*
  * Flush (discard) any saved file state, including buffer contents.
  */
@@ -709,6 +1091,7 @@ public void ch_flush(void)
 {
 	struct bufnode *bn;
 
+	clr_line_cache();
 	if (thisfile == NULL)
 		return;
 
@@ -734,8 +1117,8 @@ public void ch_flush(void)
 	 * Seek to a known position: the beginning of the file.
 	 */
 	ch_fpos = 0;
-	ch_block = 0; /* ch_fpos / LBUFSIZE; */
-	ch_offset = 0; /* ch_fpos % LBUFSIZE; */
+	ch_block = 0; /* ch_fpos / ch_blksize; */
+	ch_offset = 0; /* ch_fpos % ch_blksize; */
 
 	if (ch_flags & CH_NOTRUSTSIZE)
 	{
@@ -745,6 +1128,7 @@ public void ch_flush(void)
 	{
 		ch_fsize = (ch_flags & CH_HELPFILE) ? size_helpdata : filesize(ch_file);
 	}
+	ch_remap();
 
 	if (less_lseek(ch_file, (less_off_t)0, SEEK_SET) == BAD_LSEEK)
 	{
@@ -770,11 +1154,12 @@ static int ch_addbuf(void)
 	 * Allocate and initialize a new buffer and link it 
 	 * onto the tail of the buffer list.
 	 */
-	bp = (struct buf *) calloc(1, sizeof(struct buf));
+	bp = (struct buf *) calloc(1, sizeof(struct buf) + ch_blksize);
 	if (bp == NULL)
 		return (1);
 	ch_nbufs++;
 	bp->block = -1;
+	bp->data = (unsigned char *) (bp + 1);
 	bn = &bp->node;
 
 	BUF_INS_TAIL(bn);
@@ -873,10 +1258,18 @@ public void ch_init(int f, int flags, ssize_t nread)
 		 */
 		if ((flags & CH_CANSEEK) && !seekable(f))
 			ch_flags &= ~CH_CANSEEK;
+		thisfile->blksize = ch_calc_blksize(ch_flags);
+#if CH_READAHEAD
+		thisfile->lastmiss = -1;
+		thisfile->nseq = 0;
+		thisfile->rapos = NULL_POSITION;
+		thisfile->advice = POSIX_FADV_NORMAL;
+#endif
 		set_filestate(curr_ifile, (void *) thisfile);
 	}
 	if (thisfile->file == -1)
 		thisfile->file = f;
+	ch_calc_maxbufs();
 
 	/*
 	 * Figure out the size of the file, if we can.
@@ -893,6 +1286,10 @@ public void ch_init(int f, int flags, ssize_t nread)
 		ch_flags |= CH_NOTRUSTSIZE;
 	}
 
+	/*
+	 * This also remaps a file whose filestate was kept open,
+	 * since the file may have changed while it was not current.
+	 */
 	ch_flush();
 }
 
@@ -922,6 +1319,7 @@ public void ch_close(void)
 		 * But don't really close it if it was opened via popen(),
 		 * because pclose() wants to close it.
 		 */
+		ch_unmap();
 		if (!(ch_flags & (CH_POPENED|CH_HELPFILE)))
 			close(ch_file);
 		ch_file = -1;
@@ -938,6 +1336,16 @@ public void ch_close(void)
 	}
 }
 
+/*
+ * Return the file descriptor of the current file.
+ */
+public int ch_getfd(void)
+{
+	if (thisfile == NULL)
+		return (-1);
+	return (ch_file);
+}
+
 /*
  * Return ch_flags for the current file.
  */
@@ -87,6 +87,8 @@
 #define A_START_PASTE          75 /* must not overlap EC_* */
 #define A_END_PASTE            76 /* must not overlap EC_* */
 #define A_F_FOREVER_BELL       77
+#define A_GOFILTER             78
+#define A_GOMATCH              79
 
 /* These values must not conflict with any A_* or EC_* value. */
 #define A_INVALID              100
@@ -1652,7 +1652,7 @@ static void write_mlist(struct mlist *ml, FILE *f)
 /*
  * Make a temp name in the same directory as filename.
  */
-static char * make_tempname(constant char *filename)
+public char * make_tempname(constant char *filename)
 {
 	char lastch;
 	char *tempname = ecalloc(1, strlen(filename)+1);
@@ -1714,7 +1714,7 @@ static void copy_hist(void *uparam, struct mlist *ml, constant char *string)
 /*
  * Make a file readable only by its owner.
  */
-static void make_file_private(FILE *f)
+public void make_file_private(FILE *f)
 {
 #if HAVE_FCHMOD
 	lbool do_chmod = TRUE;
@@ -752,7 +752,7 @@ static int mca_char(char c)
 		if (incr_search)
 		{
 			/* Incremental search: do a search after every input char. */
-			int st = (search_type & (SRCH_FORW|SRCH_BACK|SRCH_NO_MATCH|SRCH_NO_REGEX|SRCH_NO_MOVE|SRCH_WRAP|SRCH_SUBSEARCH_ALL));
+			int st = (search_type & (SRCH_FORW|SRCH_BACK|SRCH_NO_MATCH|SRCH_NO_REGEX|SRCH_NO_MOVE|SRCH_WRAP|SRCH_DFA|SRCH_NO_JIT|SRCH_SUBSEARCH_ALL));
 			ssize_t save_updown;
 			constant char *pattern = get_cmdbuf();
 			if (pattern == NULL)
@@ -820,12 +820,15 @@ static void clear_buffers(void)
 	clr_linenum();
 #if HILITE_SEARCH
 	clr_hilite();
+	clr_filter();
 #endif
 	set_line_contig_pos(NULL_POSITION);
 }
 
 public void screen_trashed_num(int trashed)
 {
+	if (trashed)
+		clr_line_cache();
 	screen_trashed_value = trashed;
 }
 
@@ -1382,6 +1385,94 @@ public lbool is_ignoring_input(int action)
 	return (action != A_PREFIX);
 }
 
+#if LESSTEST
+#define LESSTEST_INDEX_STEPS 2  /* Pieces counted while waiting for each test command */
+#endif
+
+/*
+ * While waiting for the user to type a command,
+ * count lines in the current file (--index-lines).
+ */
+static void idle_index(void)
+{
+	lbool partial;
+
+	if (ungot != NULL || !indexing_linenums())
+		return;
+#if LESSTEST
+	if (is_lesstest())
+	{
+		/*
+		 * Test input can't be polled, so count a fixed number
+		 * of pieces each time, to make the prompts repeatable.
+		 */
+		int i;
+		for (i = 0;  i < LESSTEST_INDEX_STEPS;  i++)
+			if (!index_linenums())
+				break;
+		if (!sigs)
+			prompt();
+		return;
+	}
+#endif
+	if (!ttyin_pollable())
+		return;
+	partial = (index_linenums_partial() > 0);
+	while (!ttyin_ready())
+	{
+		if (!index_linenums())
+		{
+			/*
+			 * If the prompt showed a partial line count,
+			 * redisplay it with the final count.
+			 */
+			if (partial && !sigs)
+				prompt();
+			break;
+		}
+	}
+}
+
+/*
+ * While waiting for the user to type a command,
+ * count the lines shown by the filters (--filter-count).
+ */
+static void idle_filter_count(void)
+{
+	if (ungot != NULL || !counting_filter_lines() || !ttyin_pollable())
+		return;
+	while (!ttyin_ready())
+	{
+		if (!count_filter_lines())
+		{
+			/* Redisplay the prompt with the final count. */
+			if (!sigs)
+				prompt();
+			break;
+		}
+	}
+}
+
+/*
+ * While waiting for the user to type a command,
+ * index the matches for the search pattern (--index-matches).
+ */
+static void idle_match_index(void)
+{
+	if (ungot != NULL || !indexing_matches() || !ttyin_pollable())
+		return;
+	while (!ttyin_ready())
+	{
+		if (!index_search_matches())
+		{
+			/* Redisplay the prompt with the final count. */
+			if (!sigs)
+				prompt();
+			break;
+		}
+	}
+}
+
 /*
  * Main command processor.
  * Accept and execute commands until a quit command.
@@ -1438,7 +1529,12 @@ public void commands(void)
 		if (sigs)
 			continue;
 		if (newaction == A_NOACTION)
+		{
+			idle_index();
+			idle_filter_count();
+			idle_match_index();
 			c = getcc();
+		}
 
 	again:
 		if (sigs)
@@ -1713,8 +1809,11 @@ public void commands(void)
 		case A_REPAINT:
 			/*
 			 * Repaint screen.
+			 * The user may be repainting because something else
+			 * wrote on the screen, so redraw every line.
 			 */
 			cmd_exec();
+			forget_screen();
 			repaint();
 			break;
 
@@ -1735,6 +1834,32 @@ public void commands(void)
 			jump_sline = save_jump_sline;
 			break;
 
+		case A_GOFILTER:
+			/*
+			 * Go to the N-th line shown by the filters,
+			 * default the first one.
+			 */
+			if (number <= 0)
+				number = 1;
+			cmd_exec();
+			jump_filter_line(number);
+			break;
+
+		case A_GOMATCH:
+			/*
+			 * Go to the N-th line which matches the 
+			 * search pattern, default the first one.
+			 */
+			if (number <= 0)
+				number = 1;
+			cmd_exec();
+#if HILITE_SEARCH
+			goto_match(number);
+#else
+			jump_back(number);
+#endif
+			break;
+
 		case A_PERCENT:
 			/*
 			 * Go to a specified percentage into the file.
@@ -1907,7 +2032,7 @@ public void commands(void)
 
 		case A_FILTER:
 #if HILITE_SEARCH
-			search_type = SRCH_FORW | SRCH_FILTER;
+			search_type = SRCH_FORW | SRCH_FILTER | (def_search_type & (SRCH_DFA|SRCH_NO_JIT));
 			literal_char = FALSE;
 			mca_search();
 			c = getcc();
@@ -45,6 +45,45 @@ public int * cvt_alloc_chpos(size_t len)
 	return (chpos);
 }
 
+/*
+ * Would cvt_text leave this text unchanged?
+ * This is so if there are no backspaces, escape sequences or 
+ * trailing carriage return for the ops to act on, and (in UTF-8 mode)
+ * the text is well-formed, so copying it a character at a time
+ * changes nothing.  Case conversion is never an identity.
+ */
+public lbool cvt_is_identity(constant char *src, size_t len, int ops)
+{
+	constant char *p = src;
+	constant char *end = src + len;
+
+	if (ops & CVT_TO_LC)
+		return (FALSE);
+	if ((ops & CVT_CRLF) && len > 0 && end[-1] == '\r')
+		return (FALSE);
+	while (p < end)
+	{
+		int clen;
+		char c = *p;
+		if ((ops & CVT_BS) && c == '\b')
+			return (FALSE);
+		if ((ops & CVT_ANSI) && (c == ESC || (unsigned char) c == CSI))
+			return (FALSE);
+		if (!utf_mode || IS_ASCII_OCTET(c))
+		{
+			p++;
+			continue;
+		}
+		clen = utf_len(c);
+		if (clen > end - p || !is_utf8_well_formed(p, clen))
+			return (FALSE);
+		if ((ops & CVT_ANSI) && get_wchar(p) == CSI)
+			return (FALSE);
+		p += clen;
+	}
+	return (TRUE);
+}
+
 /*
  * Convert text.  Perform the transformations specified by ops.
  * Returns converted text in odst.  The original offset of each
@@ -103,6 +142,12 @@ public void cvt_text(mutable char *odst, constant char *osrc, mutable int *chpos
 		if (dst > edst)
 			edst = dst;
 	}
+	/*
+	 * Mark the end of the converted text in chpos, so that a
+	 * reused chpos array need not be initialized by the caller.
+	 */
+	if (chpos != NULL)
+		chpos[ptr_diff(edst, odst)] = -1;
 	if ((ops & CVT_CRLF) && edst > odst && edst[-1] == '\r')
 		edst--;
 	*edst = '\0';
@@ -130,6 +130,8 @@ static unsigned char cmdtable[] =
 	ESC,CONTROL('B'),0,             A_B_BRACKET,
 	'G',0,                          A_GOEND,
 	ESC,'G',0,                      A_GOEND_BUF,
+	ESC,'&',0,                      A_GOFILTER,
+	ESC,'#',0,                      A_GOMATCH,
 	ESC,'>',0,                      A_GOEND,
 	'>',0,                          A_GOEND,
 	'P',0,                          A_GOPOS,
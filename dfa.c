@@ -0,0 +1,1344 @@
+/*
+ * Copyright (C) 1984-2025  Mark Nudelman
+ *
+ * You may distribute under the terms of either the GNU General Public
+ * License or the Less License, as specified in the README file.
+ *
+ * For more information, see the README file.
+ */
+
+/*
+ * A regular expression matcher which takes time proportional to
+ * the length of the text, whatever the pattern.
+ *
+ * A pattern (in POSIX extended syntax) is compiled into a program
+ * for a nondeterministic machine.  To decide whether a line matches,
+ * the program is run as a DFA, whose states are built lazily as
+ * the text needs them and cached.  Only if the line does match is
+ * the program run again, simulating all threads of the machine
+ * in lockstep, to find the leftmost-longest match and the positions
+ * of its subexpressions.
+ *
+ * Several patterns may also be compiled together into one DFA,
+ * which finds which of them match a line in a single pass.
+ */
+
+#include "less.h"
+#include "charset.h"
+
+extern int utf_mode;
+
+#define DFA_MAX_INST    10000   /* Largest program */
+#define DFA_MAX_REPEAT  255     /* Largest count in {m,n} */
+#define DFA_MAX_STATES  512     /* Most DFA states cached at once */
+#define DFA_NCACHE      256     /* Chars whose transitions are cached */
+#define DFA_HASH_SIZE   1024
+#define DFA_MAX_PATS    32      /* Most patterns in a set */
+
+/* Instructions */
+#define OP_CHAR         0       /* Match char c, ignoring case if y */
+#define OP_ANY          1       /* Match any char */
+#define OP_SET          2       /* Match a char in set x, ignoring case if y */
+#define OP_SPLIT        3       /* Continue at both x and y */
+#define OP_JMP          4       /* Continue at x */
+#define OP_SAVE         5       /* Save position in slot x */
+#define OP_ASSERT       6       /* Continue if assertion x holds */
+#define OP_MATCH        7       /* Found a match for pattern x */
+
+/* Assertions */
+#define AS_BOL          1       /* ^ */
+#define AS_EOL          2       /* $ */
+#define AS_WORDB        3       /* \b */
+#define AS_NWORDB       4       /* \B */
+#define AS_WBEG         5       /* \< */
+#define AS_WEND         6       /* \> */
+
+/* Context of a position in the text, for assertions */
+#define CX_BOL          01      /* At beginning of line */
+#define CX_EOL          02      /* At end of line */
+#define CX_PREVW        04      /* Preceded by a word char */
+#define CX_NEXTW        010     /* Followed by a word char */
+
+/* Character classes */
+#define CL_ALNUM        1
+#define CL_ALPHA        2
+#define CL_BLANK        3
+#define CL_CNTRL        4
+#define CL_DIGIT        5
+#define CL_GRAPH        6
+#define CL_LOWER        7
+#define CL_PRINT        8
+#define CL_PUNCT        9
+#define CL_SPACE        10
+#define CL_UPPER        11
+#define CL_XDIGIT       12
+#define CL_WORD         13
+
+/* Parse tree nodes */
+#define N_EMPTY         0
+#define N_CHAR          1       /* c */
+#define N_ANY           2
+#define N_SET           3       /* Set left */
+#define N_ASSERT        4       /* Assertion left */
+#define N_CAT           5       /* left followed by right */
+#define N_ALT           6       /* left or right */
+#define N_REP           7       /* left repeated min to max times */
+#define N_GROUP         8       /* Subexpression number min is left */
+
+#define DS_UNKNOWN      0       /* Transition not computed yet */
+#define DS_MATCH        (-1)    /* Transition reaches a match */
+
+struct dfa_inst {
+	int op;
+	int x, y;
+	LWCHAR c;
+};
+
+/*
+ * A set is a list of items, each either a range of chars
+ * or (if cls is nonzero) a character class.
+ */
+struct dfa_item {
+	LWCHAR lo, hi;
+	int cls;
+};
+
+struct dfa_set {
+	int first;
+	int count;
+	lbool negate;
+};
+
+struct dfa_node {
+	int type;
+	int left, right;
+	int min, max;
+	LWCHAR c;
+};
+
+/*
+ * A DFA state is the set of instructions which threads of the
+ * machine have reached (its "kernel") plus the context needed
+ * to evaluate assertions at the current position.
+ */
+struct dfa_state {
+	int kfirst;
+	int klen;
+	int flags;
+	unsigned int matched;   /* Patterns which have matched already */
+	unsigned int eol;       /* Patterns matched at end of text, if eol_known */
+	lbool eol_known;
+	int hnext;              /* Next state in hash chain, or -1 */
+};
+
+struct dfa {
+	unsigned int all_pats;  /* Mask of all patterns */
+	struct dfa_inst *inst;
+	int ninst;
+	struct dfa_item *items;
+	int nitems;
+	struct dfa_set *sets;
+	int nsets;
+	int ncap;               /* Number of saved positions tracked */
+
+	/* Lazily built DFA */
+	struct dfa_state *states;
+	int nstates;
+	int *trans;             /* DFA_NCACHE transitions per state */
+	int *kpool;
+	int kpool_len;
+	int kpool_size;
+	int hash[DFA_HASH_SIZE];
+	int start[(CX_BOL|CX_PREVW)+1];
+
+	/* Scratch space for matching */
+	unsigned int *mark;
+	unsigned int gen;
+	int *stack;
+	int *kernel;
+	int *clist;
+	int *nlist;
+	ssize_t *ccap;
+	ssize_t *ncap_buf;
+	ssize_t *caps;
+	ssize_t *best;
+};
+
+struct parse {
+	constant char *p;
+	constant char *end;
+	struct dfa *dfa;
+	struct dfa_node *nodes;
+	int nnodes;
+	int nalloc_nodes;
+	int nalloc_inst;
+	int nalloc_items;
+	int nalloc_sets;
+	int ngroups;
+	lbool caseless;
+	constant char *err;
+};
+
+/*
+ * Make sure an array has room for n elements.
+ */
+static void * grow(void *arr, int *palloc, int n, size_t size)
+{
+	void *narr;
+	int nalloc;
+
+	if (n <= *palloc)
+		return (arr);
+	nalloc = (*palloc == 0) ? 16 : *palloc;
+	while (nalloc < n)
+		nalloc *= 2;
+	narr = ecalloc((size_t) nalloc, size);
+	if (arr != NULL)
+	{
+		memcpy(narr, arr, (size_t) *palloc * size);
+		free(arr);
+	}
+	*palloc = nalloc;
+	return (narr);
+}
+
+/*
+ * Is a char in a character class?
+ */
+static lbool in_class(int cls, LWCHAR c)
+{
+	if (c >= 128)
+	{
+		/* Only case is known for non-ASCII chars. */
+		switch (cls)
+		{
+		case CL_ALNUM: case CL_ALPHA: case CL_WORD:
+			return (IS_UPPER(c) || IS_LOWER(c));
+		case CL_UPPER:
+			return (IS_UPPER(c));
+		case CL_LOWER:
+			return (IS_LOWER(c));
+		case CL_GRAPH: case CL_PRINT:
+			return (utf_mode && !control_char(c));
+		}
+		return (FALSE);
+	}
+	switch (cls)
+	{
+	case CL_ALNUM:  return (isalnum((int) c) != 0);
+	case CL_ALPHA:  return (isalpha((int) c) != 0);
+	case CL_BLANK:  return (c == ' ' || c == '\t');
+	case CL_CNTRL:  return (iscntrl((int) c) != 0);
+	case CL_DIGIT:  return (c >= '0' && c <= '9');
+	case CL_GRAPH:  return (isgraph((int) c) != 0);
+	case CL_LOWER:  return (islower((int) c) != 0);
+	case CL_PRINT:  return (isprint((int) c) != 0);
+	case CL_PUNCT:  return (ispunct((int) c) != 0);
+	case CL_SPACE:  return (isspace((int) c) != 0);
+	case CL_UPPER:  return (isupper((int) c) != 0);
+	case CL_XDIGIT: return (isxdigit((int) c) != 0);
+	case CL_WORD:   return (c == '_' || isalnum((int) c));
+	}
+	return (FALSE);
+}
+
+static lbool is_word(LWCHAR c)
+{
+	return (in_class(CL_WORD, c));
+}
+
+static lbool in_set1(struct dfa *dfa, struct dfa_set *set, LWCHAR c)
+{
+	struct dfa_item *item = &dfa->items[set->first];
+	int i;
+
+	for (i = 0;  i < set->count;  i++, item++)
+	{
+		if (item->cls != 0 ? in_class(item->cls, c) : (c >= item->lo && c <= item->hi))
+			return (TRUE);
+	}
+	return (FALSE);
+}
+
+static lbool in_set(struct dfa *dfa, struct dfa_set *set, LWCHAR c, lbool caseless)
+{
+	lbool found = in_set1(dfa, set, c);
+	if (!found && caseless)
+		found = in_set1(dfa, set, (LWCHAR) TO_LOWER(c)) ||
+		        in_set1(dfa, set, (LWCHAR) TO_UPPER(c));
+	return (found != set->negate);
+}
+
+/*
+ * Does an instruction which consumes a char match char c?
+ */
+static lbool inst_matches(struct dfa *dfa, struct dfa_inst *ip, LWCHAR c)
+{
+	switch (ip->op)
+	{
+	case OP_CHAR:
+		if (ip->y)
+			c = (LWCHAR) TO_LOWER(c);
+		return (c == ip->c);
+	case OP_ANY:
+		return (TRUE);
+	case OP_SET:
+		return (in_set(dfa, &dfa->sets[ip->x], c, ip->y));
+	}
+	return (FALSE);
+}
+
+static lbool assert_ok(int as, int flags)
+{
+	switch (as)
+	{
+	case AS_BOL:    return ((flags & CX_BOL) != 0);
+	case AS_EOL:    return ((flags & CX_EOL) != 0);
+	case AS_WORDB:  return (!(flags & CX_PREVW) != !(flags & CX_NEXTW));
+	case AS_NWORDB: return (!(flags & CX_PREVW) == !(flags & CX_NEXTW));
+	case AS_WBEG:   return (!(flags & CX_PREVW) && (flags & CX_NEXTW));
+	case AS_WEND:   return ((flags & CX_PREVW) && !(flags & CX_NEXTW));
+	}
+	return (FALSE);
+}
+
+/* ---- Parsing ---- */
+
+static int new_node(struct parse *ps, int type, int left, int right)
+{
+	struct dfa_node *np;
+
+	ps->nodes = (struct dfa_node *) grow(ps->nodes, &ps->nalloc_nodes, ps->nnodes+1, sizeof(struct dfa_node));
+	np = &ps->nodes[ps->nnodes];
+	np->type = type;
+	np->left = left;
+	np->right = right;
+	np->min = np->max = 0;
+	np->c = 0;
+	return (ps->nnodes++);
+}
+
+/*
+ * Get the next char of the pattern.
+ */
+static LWCHAR next_char(struct parse *ps)
+{
+	return (step_charc(&ps->p, +1, ps->end));
+}
+
+/*
+ * Start a new set.
+ */
+static int new_set(struct parse *ps, lbool negate)
+{
+	struct dfa *dfa = ps->dfa;
+	struct dfa_set *set;
+
+	dfa->sets = (struct dfa_set *) grow(dfa->sets, &ps->nalloc_sets, dfa->nsets+1, sizeof(struct dfa_set));
+	set = &dfa->sets[dfa->nsets];
+	set->first = dfa->nitems;
+	set->count = 0;
+	set->negate = negate;
+	return (dfa->nsets++);
+}
+
+/*
+ * Add a range or class to the last set.
+ */
+static void add_item(struct parse *ps, LWCHAR lo, LWCHAR hi, int cls)
+{
+	struct dfa *dfa = ps->dfa;
+	struct dfa_item *item;
+
+	dfa->items = (struct dfa_item *) grow(dfa->items, &ps->nalloc_items, dfa->nitems+1, sizeof(struct dfa_item));
+	item = &dfa->items[dfa->nitems++];
+	item->lo = lo;
+	item->hi = hi;
+	item->cls = cls;
+	dfa->sets[dfa->nsets-1].count++;
+}
+
+static int class_node(struct parse *ps, int cls, lbool negate)
+{
+	int n = new_node(ps, N_SET, new_set(ps, negate), 0);
+	add_item(ps, 0, 0, cls);
+	return (n);
+}
+
+/*
+ * Parse a class name in a bracket expression; p points after "[:".
+ */
+static int parse_class_name(struct parse *ps)
+{
+	static struct { constant char *name; int cls; } classes[] = {
+		{ "alnum", CL_ALNUM }, { "alpha", CL_ALPHA }, { "blank", CL_BLANK },
+		{ "cntrl", CL_CNTRL }, { "digit", CL_DIGIT }, { "graph", CL_GRAPH },
+		{ "lower", CL_LOWER }, { "print", CL_PRINT }, { "punct", CL_PUNCT },
+		{ "space", CL_SPACE }, { "upper", CL_UPPER }, { "xdigit", CL_XDIGIT },
+	};
+	constant char *e;
+	size_t len;
+	int i;
+
+	for (e = ps->p;  e + 1 < ps->end && !(e[0] == ':' && e[1] == ']');  e++)
+		continue;
+	if (e + 1 >= ps->end)
+	{
+		ps->err = "Unmatched [";
+		return (0);
+	}
+	len = ptr_diff(e, ps->p);
+	for (i = 0;  i < (int) countof(classes);  i++)
+	{
+		if (strlen(classes[i].name) == len && strncmp(classes[i].name, ps->p, len) == 0)
+		{
+			ps->p = e + 2;
+			return (classes[i].cls);
+		}
+	}
+	ps->err = "Invalid character class name";
+	return (0);
+}
+
+/*
+ * Parse a bracket expression; p points after the "[".
+ */
+static int parse_bracket(struct parse *ps)
+{
+	lbool negate = FALSE;
+	int set;
+	lbool first = TRUE;
+
+	if (ps->p < ps->end && *ps->p == '^')
+	{
+		negate = TRUE;
+		ps->p++;
+	}
+	set = new_set(ps, negate);
+	for (;;)
+	{
+		LWCHAR lo, hi;
+		if (ps->p >= ps->end)
+		{
+			ps->err = "Unmatched [";
+			return (-1);
+		}
+		if (*ps->p == ']' && !first)
+		{
+			ps->p++;
+			break;
+		}
+		first = FALSE;
+		if (ps->p[0] == '[' && ps->p + 1 < ps->end && ps->p[1] == ':')
+		{
+			int cls;
+			ps->p += 2;
+			if ((cls = parse_class_name(ps)) == 0)
+				return (-1);
+			add_item(ps, 0, 0, cls);
+			continue;
+		}
+		if (ps->p[0] == '[' && ps->p + 1 < ps->end && (ps->p[1] == '.' || ps->p[1] == '='))
+		{
+			/* Collating element or equivalence class of one char. */
+			char delim = ps->p[1];
+			ps->p += 2;
+			lo = next_char(ps);
+			if (ps->p + 1 >= ps->end || ps->p[0] != delim || ps->p[1] != ']')
+			{
+				ps->err = "Invalid collation character";
+				return (-1);
+			}
+			ps->p += 2;
+		} else
+			lo = next_char(ps);
+		hi = lo;
+		if (ps->p + 1 < ps->end && ps->p[0] == '-' && ps->p[1] != ']')
+		{
+			ps->p++;
+			hi = next_char(ps);
+			if (hi < lo)
+			{
+				ps->err = "Invalid range end";
+				return (-1);
+			}
+		}
+		add_item(ps, lo, hi, 0);
+	}
+	return (new_node(ps, N_SET, set, 0));
+}
+
+/*
+ * Parse a number in an interval expression.
+ */
+static int parse_count(struct parse *ps)
+{
+	int n = 0;
+	if (ps->p >= ps->end || *ps->p < '0' || *ps->p > '9')
+		return (-1);
+	while (ps->p < ps->end && *ps->p >= '0' && *ps->p <= '9')
+	{
+		n = n * 10 + (*ps->p++ - '0');
+		if (n > DFA_MAX_REPEAT)
+		{
+			ps->err = "Count too large in {}";
+			return (-1);
+		}
+	}
+	return (n);
+}
+
+static int parse_alt(struct parse *ps, int depth);
+
+/*
+ * Parse an atom: a char, a bracket expression, a group, and so on.
+ * Return -1 on error, or -2 if there is no atom here.
+ */
+static int parse_atom(struct parse *ps, int depth)
+{
+	int n;
+	LWCHAR c;
+
+	switch (*ps->p)
+	{
+	case '|':
+	case ')':
+		return (-2);
+	case '(': {
+		int group = ++ps->ngroups;
+		int sub;
+		ps->p++;
+		if ((sub = parse_alt(ps, depth+1)) < 0)
+			return (-1);
+		if (ps->p >= ps->end || *ps->p != ')')
+		{
+			ps->err = "Unmatched ( or \\(";
+			return (-1);
+		}
+		ps->p++;
+		n = new_node(ps, N_GROUP, sub, 0);
+		ps->nodes[n].min = group;
+		return (n); }
+	case '[':
+		ps->p++;
+		return (parse_bracket(ps));
+	case '.':
+		ps->p++;
+		return (new_node(ps, N_ANY, 0, 0));
+	case '^':
+		ps->p++;
+		return (new_node(ps, N_ASSERT, AS_BOL, 0));
+	case '$':
+		ps->p++;
+		return (new_node(ps, N_ASSERT, AS_EOL, 0));
+	case '\\':
+		ps->p++;
+		if (ps->p >= ps->end)
+		{
+			ps->err = "Trailing backslash";
+			return (-1);
+		}
+		switch (*ps->p)
+		{
+		case 'w': ps->p++; return (class_node(ps, CL_WORD, FALSE));
+		case 'W': ps->p++; return (class_node(ps, CL_WORD, TRUE));
+		case 's': ps->p++; return (class_node(ps, CL_SPACE, FALSE));
+		case 'S': ps->p++; return (class_node(ps, CL_SPACE, TRUE));
+		case 'b': ps->p++; return (new_node(ps, N_ASSERT, AS_WORDB, 0));
+		case 'B': ps->p++; return (new_node(ps, N_ASSERT, AS_NWORDB, 0));
+		case '<': ps->p++; return (new_node(ps, N_ASSERT, AS_WBEG, 0));
+		case '>': ps->p++; return (new_node(ps, N_ASSERT, AS_WEND, 0));
+		case '`': ps->p++; return (new_node(ps, N_ASSERT, AS_BOL, 0));
+		case '\'': ps->p++; return (new_node(ps, N_ASSERT, AS_EOL, 0));
+		}
+		if (*ps->p >= '1' && *ps->p <= '9')
+		{
+			ps->err = "Back references are not supported";
+			return (-1);
+		}
+		break;
+	}
+	c = next_char(ps);
+	n = new_node(ps, N_CHAR, 0, 0);
+	ps->nodes[n].c = ps->caseless ? (LWCHAR) TO_LOWER(c) : c;
+	return (n);
+}
+
+/*
+ * Parse an atom followed by any number of repetition operators.
+ */
+static int parse_piece(struct parse *ps, int depth)
+{
+	int n = parse_atom(ps, depth);
+	if (n < 0)
+		return (n);
+	while (ps->p < ps->end)
+	{
+		int min, max;
+		constant char *save = ps->p;
+		switch (*ps->p)
+		{
+		case '*': min = 0; max = -1; ps->p++; break;
+		case '+': min = 1; max = -1; ps->p++; break;
+		case '?': min = 0; max = 1;  ps->p++; break;
+		case '{':
+			ps->p++;
+			if ((min = parse_count(ps)) < 0)
+			{
+				if (ps->err != NULL)
+					return (-1);
+				/* Not an interval; treat "{" as a literal. */
+				ps->p = save;
+				return (n);
+			}
+			max = min;
+			if (ps->p < ps->end && *ps->p == ',')
+			{
+				ps->p++;
+				max = (ps->p < ps->end && *ps->p == '}') ? -1 : parse_count(ps);
+				if (ps->err != NULL)
+					return (-1);
+			}
+			if (ps->p >= ps->end || *ps->p != '}' || (max >= 0 && max < min))
+			{
+				ps->err = "Invalid content of \\{\\}";
+				return (-1);
+			}
+			ps->p++;
+			break;
+		default:
+			return (n);
+		}
+		n = new_node(ps, N_REP, n, 0);
+		ps->nodes[n].min = min;
+		ps->nodes[n].max = max;
+	}
+	return (n);
+}
+
+/*
+ * Parse a sequence of pieces.
+ */
+static int parse_cat(struct parse *ps, int depth)
+{
+	int n = new_node(ps, N_EMPTY, 0, 0);
+	lbool first = TRUE;
+
+	while (ps->p < ps->end)
+	{
+		int p;
+		if (first && (*ps->p == '*' || *ps->p == '+' || *ps->p == '?'))
+		{
+			/* A leading repetition operator is literal. */
+			p = new_node(ps, N_CHAR, 0, 0);
+			ps->nodes[p].c = (LWCHAR) *ps->p++;
+		} else if ((p = parse_piece(ps, depth)) == -2)
+			break;
+		if (p < 0)
+			return (-1);
+		n = first ? p : new_node(ps, N_CAT, n, p);
+		first = FALSE;
+	}
+	return (n);
+}
+
+/*
+ * Parse alternatives separated by "|".
+ */
+static int parse_alt(struct parse *ps, int depth)
+{
+	int n;
+
+	if (depth > 100)
+	{
+		ps->err = "Too many nested parentheses";
+		return (-1);
+	}
+	if ((n = parse_cat(ps, depth)) < 0)
+		return (-1);
+	while (ps->p < ps->end && *ps->p == '|')
+	{
+		int r;
+		ps->p++;
+		if ((r = parse_cat(ps, depth)) < 0)
+			return (-1);
+		n = new_node(ps, N_ALT, n, r);
+	}
+	if (depth == 0 && ps->p < ps->end)
+	{
+		ps->err = "Unmatched ) or \\)";
+		return (-1);
+	}
+	return (n);
+}
+
+/* ---- Code generation ---- */
+
+static int emit(struct parse *ps, int op, int x, int y)
+{
+	struct dfa *dfa = ps->dfa;
+	struct dfa_inst *ip;
+
+	if (dfa->ninst >= DFA_MAX_INST)
+	{
+		ps->err = "Pattern is too complex";
+		return (-1);
+	}
+	dfa->inst = (struct dfa_inst *) grow(dfa->inst, &ps->nalloc_inst, dfa->ninst+1, sizeof(struct dfa_inst));
+	ip = &dfa->inst[dfa->ninst];
+	ip->op = op;
+	ip->x = x;
+	ip->y = y;
+	ip->c = 0;
+	return (dfa->ninst++);
+}
+
+static int gen(struct parse *ps, int n)
+{
+	struct dfa_node *np = &ps->nodes[n];
+	int pc, i;
+
+	switch (np->type)
+	{
+	case N_EMPTY:
+		return (0);
+	case N_CHAR:
+		if ((pc = emit(ps, OP_CHAR, 0, ps->caseless)) < 0)
+			return (-1);
+		ps->dfa->inst[pc].c = np->c;
+		return (0);
+	case N_ANY:
+		return (emit(ps, OP_ANY, 0, 0) < 0 ? -1 : 0);
+	case N_SET:
+		return (emit(ps, OP_SET, np->left, ps->caseless) < 0 ? -1 : 0);
+	case N_ASSERT:
+		return (emit(ps, OP_ASSERT, np->left, 0) < 0 ? -1 : 0);
+	case N_CAT:
+		if (gen(ps, np->left) < 0)
+			return (-1);
+		return (gen(ps, np->right));
+	case N_ALT: {
+		int split, jmp;
+		if ((split = emit(ps, OP_SPLIT, 0, 0)) < 0)
+			return (-1);
+		ps->dfa->inst[split].x = split + 1;
+		if (gen(ps, np->left) < 0 || (jmp = emit(ps, OP_JMP, 0, 0)) < 0)
+			return (-1);
+		ps->dfa->inst[split].y = jmp + 1;
+		if (gen(ps, np->right) < 0)
+			return (-1);
+		ps->dfa->inst[jmp].x = ps->dfa->ninst;
+		return (0); }
+	case N_GROUP:
+		if (emit(ps, OP_SAVE, 2 * np->min, 0) < 0 || gen(ps, np->left) < 0)
+			return (-1);
+		return (emit(ps, OP_SAVE, 2 * np->min + 1, 0) < 0 ? -1 : 0);
+	case N_REP: {
+		int min = np->min;
+		int max = np->max;
+		int sub = np->left;
+		int first_opt;
+		for (i = 0;  i < min;  i++)
+			if (gen(ps, sub) < 0)
+				return (-1);
+		if (max < 0)
+		{
+			/* L: split L+1, out; sub; jmp L; out: */
+			int split = emit(ps, OP_SPLIT, 0, 0);
+			if (split < 0 || gen(ps, sub) < 0 || emit(ps, OP_JMP, split, 0) < 0)
+				return (-1);
+			ps->dfa->inst[split].x = split + 1;
+			ps->dfa->inst[split].y = ps->dfa->ninst;
+			return (0);
+		}
+		/* Each optional copy may be skipped to the end. */
+		first_opt = ps->dfa->ninst;
+		for (i = min;  i < max;  i++)
+		{
+			int split = emit(ps, OP_SPLIT, 0, 0);
+			if (split < 0)
+				return (-1);
+			ps->dfa->inst[split].x = split + 1;
+			if (gen(ps, sub) < 0)
+				return (-1);
+		}
+		for (pc = first_opt;  pc < ps->dfa->ninst;  pc++)
+			if (ps->dfa->inst[pc].op == OP_SPLIT && ps->dfa->inst[pc].y == 0 && ps->dfa->inst[pc].x == pc + 1)
+				ps->dfa->inst[pc].y = ps->dfa->ninst;
+		return (0); }
+	}
+	return (0);
+}
+
+/*
+ * Free a compiled pattern.
+ */
+public void dfa_free(struct dfa *dfa)
+{
+	if (dfa == NULL)
+		return;
+	free(dfa->inst);
+	free(dfa->items);
+	free(dfa->sets);
+	free(dfa->states);
+	free(dfa->trans);
+	free(dfa->kpool);
+	free(dfa->mark);
+	free(dfa->stack);
+	free(dfa->kernel);
+	free(dfa->clist);
+	free(dfa->nlist);
+	free(dfa->ccap);
+	free(dfa->ncap_buf);
+	free(dfa->caps);
+	free(dfa->best);
+	free(dfa);
+}
+
+/*
+ * Forget all cached DFA states.
+ */
+static void dfa_reset(struct dfa *dfa)
+{
+	int i;
+
+	dfa->nstates = 0;
+	dfa->kpool_len = 0;
+	for (i = 0;  i < DFA_HASH_SIZE;  i++)
+		dfa->hash[i] = -1;
+	for (i = 0;  i < (int) countof(dfa->start);  i++)
+		dfa->start[i] = -1;
+}
+
+/*
+ * Compile a set of patterns.
+ * If there is only one, also prepare to find where it matches.
+ * Return NULL and set *perr to a message if a pattern is invalid.
+ */
+public struct dfa * dfa_compile_set(constant char **patterns, lbool *caseless, int npats, constant char **perr)
+{
+	struct parse ps;
+	struct dfa *dfa;
+	int i;
+	int n;
+
+	if (npats > DFA_MAX_PATS)
+	{
+		*perr = "Too many patterns";
+		return (NULL);
+	}
+	dfa = (struct dfa *) ecalloc(1, sizeof(struct dfa));
+	dfa->all_pats = (npats == DFA_MAX_PATS) ? ~0U : (1U << npats) - 1;
+	ps.dfa = dfa;
+	ps.nodes = NULL;
+	ps.nalloc_nodes = 0;
+	ps.nalloc_inst = ps.nalloc_items = ps.nalloc_sets = 0;
+	ps.ngroups = 0;
+	ps.err = NULL;
+
+	/*
+	 * The program for one pattern is: save 0; pattern; save 1; match.
+	 * For a set, it is: split p0, L1; L1: split p1, L2; ... pN,
+	 * where each pI is: pattern I; match I.
+	 */
+	for (i = 0;  i < npats && ps.err == NULL;  i++)
+	{
+		int root;
+		int split = -1;
+		ps.p = patterns[i];
+		ps.end = patterns[i] + strlen(patterns[i]);
+		ps.caseless = caseless[i];
+		ps.nnodes = 0;
+		if ((root = parse_alt(&ps, 0)) < 0)
+			break;
+		if (i < npats-1 && (split = emit(&ps, OP_SPLIT, 0, 0)) < 0)
+			break;
+		if (split >= 0)
+			dfa->inst[split].x = split + 1;
+		if (npats == 1 && emit(&ps, OP_SAVE, 0, 0) < 0)
+			break;
+		if (gen(&ps, root) < 0)
+			break;
+		if (npats == 1 && emit(&ps, OP_SAVE, 1, 0) < 0)
+			break;
+		if (emit(&ps, OP_MATCH, i, 0) < 0)
+			break;
+		if (split >= 0)
+			dfa->inst[split].y = dfa->ninst;
+	}
+	free(ps.nodes);
+	if (ps.err != NULL)
+	{
+		*perr = ps.err;
+		dfa_free(dfa);
+		return (NULL);
+	}
+
+	/* Track only the subexpressions which can be highlighted. */
+	dfa->ncap = 2 * ((ps.ngroups < NUM_SEARCH_COLORS) ? ps.ngroups + 1 : NUM_SEARCH_COLORS + 1);
+	n = dfa->ninst;
+	dfa->states = (struct dfa_state *) ecalloc(DFA_MAX_STATES, sizeof(struct dfa_state));
+	dfa->trans = (int *) ecalloc((size_t) DFA_MAX_STATES * DFA_NCACHE, sizeof(int));
+	dfa->kpool_size = 4 * n;
+	dfa->kpool = (int *) ecalloc((size_t) dfa->kpool_size, sizeof(int));
+	dfa->mark = (unsigned int *) ecalloc((size_t) n, sizeof(unsigned int));
+	dfa->stack = (int *) ecalloc((size_t) (3 * n + 1), 2 * sizeof(int));
+	dfa->kernel = (int *) ecalloc((size_t) n, sizeof(int));
+	dfa->clist = (int *) ecalloc((size_t) n, sizeof(int));
+	dfa->nlist = (int *) ecalloc((size_t) n, sizeof(int));
+	if (npats == 1)
+	{
+		dfa->ccap = (ssize_t *) ecalloc((size_t) (n * dfa->ncap), sizeof(ssize_t));
+		dfa->ncap_buf = (ssize_t *) ecalloc((size_t) (n * dfa->ncap), sizeof(ssize_t));
+		dfa->caps = (ssize_t *) ecalloc((size_t) dfa->ncap, sizeof(ssize_t));
+		dfa->best = (ssize_t *) ecalloc((size_t) dfa->ncap, sizeof(ssize_t));
+	}
+	dfa_reset(dfa);
+	return (dfa);
+}
+
+/*
+ * Compile a pattern.
+ * Return NULL and set *perr to a message if the pattern is invalid.
+ */
+public struct dfa * dfa_compile(constant char *pattern, lbool caseless, constant char **perr)
+{
+	return (dfa_compile_set(&pattern, &caseless, 1, perr));
+}
+
+/* ---- DFA ---- */
+
+static unsigned int new_gen(struct dfa *dfa)
+{
+	if (++dfa->gen == 0)
+	{
+		memset(dfa->mark, 0, (size_t) dfa->ninst * sizeof(unsigned int));
+		dfa->gen = 1;
+	}
+	return (dfa->gen);
+}
+
+static int cmp_int(constant void *a, constant void *b)
+{
+	return (*(constant int *) a - *(constant int *) b);
+}
+
+/*
+ * Find the state with a given kernel, flags and set of matched patterns,
+ * adding it if necessary.
+ * Set *preset if the cache was full and had to be cleared first.
+ */
+static int find_state(struct dfa *dfa, int *kernel, int klen, int flags, unsigned int matched, lbool *preset)
+{
+	unsigned int h = (unsigned int) flags ^ matched;
+	struct dfa_state *sp;
+	int i;
+	int s;
+
+	qsort(kernel, (size_t) klen, sizeof(int), cmp_int);
+	for (i = 0;  i < klen;  i++)
+		h = h * 31 + (unsigned int) kernel[i];
+	h %= DFA_HASH_SIZE;
+	for (s = dfa->hash[h];  s >= 0;  s = dfa->states[s].hnext)
+	{
+		sp = &dfa->states[s];
+		if (sp->flags == flags && sp->matched == matched && sp->klen == klen &&
+		    memcmp(&dfa->kpool[sp->kfirst], kernel, (size_t) klen * sizeof(int)) == 0)
+			return (s);
+	}
+	if (dfa->nstates >= DFA_MAX_STATES || dfa->kpool_len + klen > dfa->kpool_size)
+	{
+		dfa_reset(dfa);
+		*preset = TRUE;
+	}
+	s = dfa->nstates++;
+	sp = &dfa->states[s];
+	sp->kfirst = dfa->kpool_len;
+	sp->klen = klen;
+	sp->flags = flags;
+	sp->matched = matched;
+	sp->eol_known = FALSE;
+	sp->hnext = dfa->hash[h];
+	dfa->hash[h] = s;
+	memcpy(&dfa->kpool[dfa->kpool_len], kernel, (size_t) klen * sizeof(int));
+	dfa->kpool_len += klen;
+	memset(&dfa->trans[s * DFA_NCACHE], 0, DFA_NCACHE * sizeof(int));
+	return (s);
+}
+
+/*
+ * Follow the empty transitions from a state's kernel, given
+ * the context flags at the current position.
+ * Leave the instructions which consume a char in dfa->clist,
+ * and return the number of them.
+ * Add any patterns which match here to *pmatched.
+ */
+static int closure(struct dfa *dfa, int s, int flags, unsigned int *pmatched)
+{
+	struct dfa_state *sp = &dfa->states[s];
+	unsigned int g = new_gen(dfa);
+	int *stack = dfa->stack;
+	int nstack = 0;
+	int n = 0;
+	int i;
+
+	/* Push in reverse, so instructions are visited in order. */
+	for (i = sp->klen;  --i >= 0; )
+		stack[nstack++] = dfa->kpool[sp->kfirst + i];
+	while (nstack > 0)
+	{
+		int pc = stack[--nstack];
+		struct dfa_inst *ip = &dfa->inst[pc];
+		if (dfa->mark[pc] == g)
+			continue;
+		dfa->mark[pc] = g;
+		switch (ip->op)
+		{
+		case OP_MATCH:
+			*pmatched |= 1U << ip->x;
+			break;
+		case OP_JMP:
+			stack[nstack++] = ip->x;
+			break;
+		case OP_SPLIT:
+			stack[nstack++] = ip->y;
+			stack[nstack++] = ip->x;
+			break;
+		case OP_SAVE:
+			stack[nstack++] = pc + 1;
+			break;
+		case OP_ASSERT:
+			if (assert_ok(ip->x, flags))
+				stack[nstack++] = pc + 1;
+			break;
+		default:
+			dfa->clist[n++] = pc;
+			break;
+		}
+	}
+	return (n);
+}
+
+/*
+ * Compute the transition from state s on char c.
+ * Return DS_MATCH if every pattern has then matched.
+ */
+static int dfa_step(struct dfa *dfa, int s, LWCHAR c)
+{
+	int flags = dfa->states[s].flags;
+	unsigned int matched = dfa->states[s].matched;
+	lbool w = is_word(c);
+	int n, i;
+	int klen = 0;
+	unsigned int g;
+	int ns;
+	lbool reset = FALSE;
+
+	n = closure(dfa, s, flags | (w ? CX_NEXTW : 0), &matched);
+	if (matched == dfa->all_pats)
+		ns = DS_MATCH;
+	else
+	{
+		g = new_gen(dfa);
+		for (i = 0;  i < n;  i++)
+		{
+			int pc = dfa->clist[i];
+			if (inst_matches(dfa, &dfa->inst[pc], c) && dfa->mark[pc+1] != g)
+			{
+				dfa->mark[pc+1] = g;
+				dfa->kernel[klen++] = pc + 1;
+			}
+		}
+		/* A match may start at any position. */
+		if (dfa->mark[0] != g)
+			dfa->kernel[klen++] = 0;
+		ns = find_state(dfa, dfa->kernel, klen, w ? CX_PREVW : 0, matched, &reset);
+	}
+	if (!reset && c < DFA_NCACHE)
+		dfa->trans[s * DFA_NCACHE + (int) c] = (ns == DS_MATCH) ? DS_MATCH : ns + 1;
+	return (ns);
+}
+
+/*
+ * Which patterns have matched in state s at the end of the text?
+ */
+static unsigned int dfa_eol(struct dfa *dfa, int s)
+{
+	struct dfa_state *sp = &dfa->states[s];
+	if (!sp->eol_known)
+	{
+		unsigned int matched = sp->matched;
+		(void) closure(dfa, s, sp->flags | CX_EOL, &matched);
+		sp->eol = matched;
+		sp->eol_known = TRUE;
+	}
+	return (sp->eol);
+}
+
+/*
+ * Get the context flags which depend on the char before position off.
+ */
+static int prev_flags(constant char *line, size_t off, lbool notbol)
+{
+	constant char *p = line + off;
+	int flags = 0;
+
+	if (off == 0)
+	{
+		if (!notbol)
+			flags |= CX_BOL;
+	} else if (is_word(step_charc(&p, -1, line)))
+		flags |= CX_PREVW;
+	return (flags);
+}
+
+/*
+ * Which patterns match anywhere in the text?
+ */
+static unsigned int dfa_search(struct dfa *dfa, constant char *line, size_t line_len, size_t line_off, lbool notbol)
+{
+	constant char *p = line + line_off;
+	constant char *end = line + line_len;
+	int flags = prev_flags(line, line_off, notbol);
+	int s;
+
+	s = dfa->start[flags];
+	if (s < 0)
+	{
+		lbool reset = FALSE;
+		int k = 0;
+		s = dfa->start[flags] = find_state(dfa, &k, 1, flags, 0, &reset);
+	}
+	if (!utf_mode)
+	{
+		while (p < end)
+		{
+			int t = dfa->trans[s * DFA_NCACHE + (unsigned char) *p];
+			if (t == DS_UNKNOWN)
+			{
+				t = dfa_step(dfa, s, (LWCHAR) (unsigned char) *p);
+				if (t == DS_MATCH)
+					return (dfa->all_pats);
+				s = t;
+			} else if (t == DS_MATCH)
+				return (dfa->all_pats);
+			else
+				s = t - 1;
+			p++;
+		}
+	} else
+	{
+		while (p < end)
+		{
+			int t;
+			LWCHAR c;
+			if (IS_ASCII_OCTET(*p))
+			{
+				c = (LWCHAR) (unsigned char) *p++;
+				t = dfa->trans[s * DFA_NCACHE + (int) c];
+			} else
+			{
+				c = step_charc(&p, +1, end);
+				t = DS_UNKNOWN;
+			}
+			if (t == DS_UNKNOWN)
+			{
+				t = dfa_step(dfa, s, c);
+				if (t == DS_MATCH)
+					return (dfa->all_pats);
+				s = t;
+			} else if (t == DS_MATCH)
+				return (dfa->all_pats);
+			else
+				s = t - 1;
+		}
+	}
+	return (dfa_eol(dfa, s));
+}
+
+/* ---- Finding the match ---- */
+
+/*
+ * Add a thread at instruction pc, with saved positions caps,
+ * to a thread list, following empty transitions.
+ * Record any match reached in dfa->best.
+ */
+static void add_thread(struct dfa *dfa, int *list, ssize_t *lcaps, int *pn, int pc0, ssize_t pos, int flags, ssize_t *pbest_end)
+{
+	int *stack = dfa->stack;
+	int nstack = 0;
+	ssize_t *caps = dfa->caps;
+	int ncap = dfa->ncap;
+
+	/* Each entry is a pc, or -1 and a slot to restore from the next entry. */
+	stack[nstack++] = pc0;
+	while (nstack > 0)
+	{
+		int pc = stack[--nstack];
+		struct dfa_inst *ip;
+		if (pc < 0)
+		{
+			int slot = stack[--nstack];
+			caps[slot] = (ssize_t) stack[--nstack];
+			continue;
+		}
+		if (dfa->mark[pc] == dfa->gen)
+			continue;
+		dfa->mark[pc] = dfa->gen;
+		ip = &dfa->inst[pc];
+		switch (ip->op)
+		{
+		case OP_MATCH:
+			if (dfa->best[0] < 0 || caps[0] < dfa->best[0] ||
+			    (caps[0] == dfa->best[0] && pos > *pbest_end))
+			{
+				memcpy(dfa->best, caps, (size_t) ncap * sizeof(ssize_t));
+				*pbest_end = pos;
+			}
+			break;
+		case OP_JMP:
+			stack[nstack++] = ip->x;
+			break;
+		case OP_SPLIT:
+			stack[nstack++] = ip->y;
+			stack[nstack++] = ip->x;
+			break;
+		case OP_SAVE:
+			if (ip->x < ncap)
+			{
+				stack[nstack++] = (int) caps[ip->x];
+				stack[nstack++] = ip->x;
+				stack[nstack++] = -1;
+				caps[ip->x] = pos;
+			}
+			stack[nstack++] = pc + 1;
+			break;
+		case OP_ASSERT:
+			if (assert_ok(ip->x, flags))
+				stack[nstack++] = pc + 1;
+			break;
+		default:
+			list[*pn] = pc;
+			memcpy(&lcaps[*pn * ncap], caps, (size_t) ncap * sizeof(ssize_t));
+			(*pn)++;
+			break;
+		}
+	}
+}
+
+/*
+ * Get the context flags at position pos.
+ */
+static int pos_flags(constant char *line, size_t line_len, size_t pos, int prevw, lbool notbol)
+{
+	int flags = prevw;
+	if (pos == 0 && !notbol)
+		flags |= CX_BOL;
+	if (pos >= line_len)
+		flags |= CX_EOL;
+	else
+	{
+		constant char *p = line + pos;
+		if (is_word(step_charc(&p, +1, line + line_len)))
+			flags |= CX_NEXTW;
+	}
+	return (flags);
+}
+
+/*
+ * Find the leftmost-longest match, which is known to exist.
+ */
+static void dfa_find(struct dfa *dfa, constant char *line, size_t line_len, size_t line_off, lbool notbol, ssize_t *pbest_end)
+{
+	int ncap = dfa->ncap;
+	int *clist = dfa->nlist;
+	int *nlist = dfa->clist;
+	ssize_t *ccap = dfa->ccap;
+	ssize_t *ncapv = dfa->ncap_buf;
+	int cn = 0;
+	int nn;
+	size_t pos = line_off;
+	int prevw = prev_flags(line, line_off, TRUE) & CX_PREVW;
+	int i;
+
+	for (i = 0;  i < ncap;  i++)
+		dfa->caps[i] = dfa->best[i] = -1;
+	*pbest_end = -1;
+	(void) new_gen(dfa);
+	add_thread(dfa, clist, ccap, &cn, 0, (ssize_t) pos,
+		pos_flags(line, line_len, pos, prevw, notbol), pbest_end);
+	while (pos < line_len)
+	{
+		constant char *p = line + pos;
+		LWCHAR c = step_charc(&p, +1, line + line_len);
+		size_t npos = ptr_diff(p, line);
+		int flags;
+		int *tl;
+		ssize_t *tc;
+
+		prevw = is_word(c) ? CX_PREVW : 0;
+		flags = pos_flags(line, line_len, npos, prevw, notbol);
+		nn = 0;
+		(void) new_gen(dfa);
+		for (i = 0;  i < cn;  i++)
+		{
+			ssize_t *tcaps = &ccap[i * ncap];
+			/* A thread which started after the best match can't beat it. */
+			if (dfa->best[0] >= 0 && tcaps[0] > dfa->best[0])
+				continue;
+			if (!inst_matches(dfa, &dfa->inst[clist[i]], c))
+				continue;
+			memcpy(dfa->caps, tcaps, (size_t) ncap * sizeof(ssize_t));
+			add_thread(dfa, nlist, ncapv, &nn, clist[i] + 1, (ssize_t) npos, flags, pbest_end);
+		}
+		if (dfa->best[0] < 0)
+		{
+			/* Start a new thread here. */
+			for (i = 0;  i < ncap;  i++)
+				dfa->caps[i] = -1;
+			add_thread(dfa, nlist, ncapv, &nn, 0, (ssize_t) npos, flags, pbest_end);
+		}
+		tl = clist; clist = nlist; nlist = tl;
+		tc = ccap; ccap = ncapv; ncapv = tc;
+		cn = nn;
+		pos = npos;
+		if (cn == 0 && dfa->best[0] >= 0)
+			break;
+	}
+	dfa->clist = nlist;
+	dfa->nlist = clist;
+	dfa->ccap = ncapv;
+	dfa->ncap_buf = ccap;
+}
+
+/*
+ * Match a compiled pattern against a line, starting at line_off.
+ * If it matches, set offs[2*i] and offs[2*i+1] to the start and end
+ * of the match (i == 0) and of each subexpression (i > 0), or to -1
+ * if a subexpression did not participate, and return the number of
+ * offsets set (at most noffs).
+ * Return 0 if there is no match.
+ */
+public int dfa_match(struct dfa *dfa, constant char *line, size_t line_len, size_t line_off, lbool notbol, ssize_t *offs, int noffs)
+{
+	ssize_t best_end;
+	int n;
+
+	if (dfa_search(dfa, line, line_len, line_off, notbol) == 0)
+		return (0);
+	dfa_find(dfa, line, line_len, line_off, notbol, &best_end);
+	if (dfa->best[0] < 0)
+		return (0); /* Can't happen */
+	dfa->best[1] = best_end;
+	n = (noffs < dfa->ncap) ? noffs : dfa->ncap;
+	memcpy(offs, dfa->best, (size_t) n * sizeof(ssize_t));
+	return (n);
+}
+
+/*
+ * Return a mask of the patterns in a set which match a line.
+ */
+public unsigned int dfa_match_set(struct dfa *dfa, constant char *line, size_t line_len)
+{
+	return (dfa_search(dfa, line, line_len, 0, FALSE));
+}
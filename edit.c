@@ -369,6 +369,10 @@ static void close_file(void)
 		store_pos(curr_ifile, &scrpos);
 		lastmark();
 	}
+	/*
+	 * Save any line numbers we have found.
+	 */
+	save_linenum_index();
 	/*
 	 * Close the file descriptor, unless it is a pipe.
 	 */
@@ -657,8 +661,11 @@ public int edit_ifile(IFILE ifile)
 		 */
 		pos_clear();
 		clr_linenum();
+		clr_line_cache();
+		load_linenum_index();
 #if HILITE_SEARCH
 		clr_hilite();
+		clr_filter();
 #endif
 		undo_osc8();
 		hshift = 0;
@@ -20,9 +20,11 @@
 #include "less.h"
 
 extern int squeeze;
+extern int sigs;
 extern int hshift;
 extern int quit_if_one_screen;
 extern int status_col;
+extern int status_line;
 extern int wordwrap;
 extern POSITION start_attnpos;
 extern POSITION end_attnpos;
@@ -31,6 +33,28 @@ extern int hilite_search;
 extern int show_attn;
 #endif
 
+/*
+ * How a line was requested, and what was found,
+ * as recorded in the line cache.
+ */
+#define LC_SKIPEOL      01
+#define LC_RSCROLL      02
+#define LC_NOCHOP       04
+#define LC_BACK         010
+
+#define LC_NEWLINE      01
+#define LC_CHOPPED      02
+
+/*
+ * Can formatted lines be saved in the line cache?
+ * The status column and status line depend on marks,
+ * which are not tracked by the cache.
+ */
+static lbool use_line_cache(void)
+{
+	return (!status_col && !status_line && !ABORT_SIGS());
+}
+
 /*
  * Set the status column.
  *  base  Position of first char in line.
@@ -92,12 +116,30 @@ public POSITION forw_line_seg(POSITION curr_pos, lbool skipeol, lbool rscroll, l
 	int backchars;
 	POSITION wrap_pos;
 	lbool skipped_leading;
+	POSITION req_pos = curr_pos;
+	int how;
+	int info;
+	lbool eoi = FALSE;
 
 	if (p_linepos != NULL)
 		*p_linepos = NULL_POSITION;
 	if (p_newline != NULL)
 		*p_newline = TRUE;
 
+	how = (skipeol ? LC_SKIPEOL : 0) | (rscroll ? LC_RSCROLL : 0) | (nochop ? LC_NOCHOP : 0);
+	if (curr_pos != NULL_POSITION && use_line_cache() &&
+	    get_cached_line(curr_pos, how, &new_pos, &base_pos, &info))
+	{
+		if (info & LC_CHOPPED)
+			quit_if_one_screen = FALSE;
+		if (p_linepos != NULL)
+			*p_linepos = base_pos;
+		if (p_newline != NULL)
+			*p_newline = (info & LC_NEWLINE) ? TRUE : FALSE;
+		set_line_contig_pos((info & LC_NEWLINE) ? NULL_POSITION : new_pos);
+		return (new_pos);
+	}
+
 get_forw_line:
 	if (curr_pos == NULL_POSITION)
 	{
@@ -116,6 +158,15 @@ get_forw_line:
 		 */
 		prep_hilite(curr_pos, NULL_POSITION, 1);
 	}
+	if (is_filtered(curr_pos))
+	{
+		/*
+		 * Skip all the lines already known to be hidden,
+		 * without reading them.
+		 */
+		curr_pos = filtered_run_end(curr_pos);
+		goto get_forw_line;
+	}
 #endif
 	if (ch_seek(curr_pos))
 	{
@@ -210,6 +261,8 @@ get_forw_line:
 			/*
 			 * End of the line.
 			 */
+			if (c == EOI)
+				eoi = TRUE;
 			backchars = pflushmbc();
 			new_pos = ch_tell();
 			if (backchars > 0 && (nochop || !chop_line()) && hshift == 0)
@@ -243,6 +296,8 @@ get_forw_line:
 				{
 					c = ch_forw_get();
 				} while (c != '\n' && c != EOI);
+				if (c == EOI)
+					eoi = TRUE;
 				new_pos = ch_tell();
 				endline = TRUE;
 				quit_if_one_screen = FALSE;
@@ -333,6 +388,8 @@ get_forw_line:
 			continue;
 		if (c != EOI)
 			(void) ch_back_get();
+		else
+			eoi = TRUE;
 		new_pos = ch_tell();
 	}
 	if (p_linepos != NULL)
@@ -340,6 +397,13 @@ get_forw_line:
 	if (p_newline != NULL)
 		*p_newline = endline;
 	set_line_contig_pos(endline ? NULL_POSITION : new_pos);
+	/*
+	 * A line which runs into the end of the file may be
+	 * incomplete, so don't cache it.
+	 */
+	if (!eoi && use_line_cache())
+		cache_line(req_pos, how, new_pos, curr_pos,
+			(endline ? LC_NEWLINE : 0) | (chopped ? LC_CHOPPED : 0));
 	return (new_pos);
 }
 
@@ -367,15 +431,39 @@ public POSITION back_line(POSITION curr_pos, lbool *p_newline)
 	int backchars;
 	POSITION wrap_pos;
 	lbool skipped_leading;
+	POSITION req_pos = curr_pos;
+	lbool newline;
+	int info;
+
+	if (p_newline == NULL)
+		p_newline = &newline;
+	if (curr_pos != NULL_POSITION && use_line_cache() &&
+	    get_cached_line(curr_pos, LC_BACK, &new_pos, &base_pos, &info))
+	{
+		if (info & LC_CHOPPED)
+			quit_if_one_screen = FALSE;
+		*p_newline = (info & LC_NEWLINE) ? TRUE : FALSE;
+		return (new_pos);
+	}
 
 get_back_line:
-	if (p_newline != NULL)
-		*p_newline = TRUE;
+	*p_newline = TRUE;
 	if (curr_pos == NULL_POSITION || curr_pos <= ch_zero())
 	{
 		null_line();
 		return (NULL_POSITION);
 	}
+#if HILITE_SEARCH
+	if (is_filtered(curr_pos-1))
+	{
+		/*
+		 * The previous line is hidden.  Skip back over
+		 * all the lines already known to be hidden.
+		 */
+		curr_pos = filtered_run_start(curr_pos-1);
+		goto get_back_line;
+	}
+#endif
 	if (ch_seek(curr_pos-1))
 	{
 		null_line();
@@ -505,8 +593,7 @@ get_back_line:
 				edisp_pos = new_pos;
 				break;
 			}
-			if (p_newline != NULL)
-				*p_newline = FALSE;
+			*p_newline = FALSE;
 		shift:
 			if (!wordwrap)
 			{
@@ -583,6 +670,9 @@ get_back_line:
 	if (status_col)
 		init_status_col(base_pos, line_position(), edisp_pos, new_pos);
 #endif
+	if (use_line_cache())
+		cache_line(req_pos, LC_BACK, begin_new_pos, base_pos,
+			(*p_newline ? LC_NEWLINE : 0) | (chopped ? LC_CHOPPED : 0));
 	return (begin_new_pos);
 }
 
@@ -619,4 +709,5 @@ public void set_attnpos(POSITION pos)
 		}
 	}
 	start_attnpos = pos;
+	clr_line_cache();
 }
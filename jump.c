@@ -15,6 +15,7 @@
 #include "less.h"
 #include "position.h"
 
+extern int sigs;
 extern int jump_sline;
 extern lbool squished;
 extern int sc_width, sc_height;
@@ -112,6 +113,38 @@ public void jump_back(LINENUM linenum)
 	}
 }
 
+/*
+ * Jump to the N-th line shown by the filters.
+ */
+public void jump_filter_line(LINENUM n)
+{
+#if HILITE_SEARCH
+	POSITION pos;
+	PARG parg;
+
+	if (!is_filtering())
+	{
+		jump_back(n);
+		return;
+	}
+	pos = filter_line_pos(n);
+	if (pos != NULL_POSITION && ch_seek(pos) == 0)
+	{
+		if (show_attn)
+			set_attnpos(pos);
+		jump_loc(pos, jump_sline);
+	} else if (!ABORT_SIGS())
+	{
+		parg.p_linenum = filter_line_count(NULL);
+		if (parg.p_linenum < 0)
+			parg.p_linenum = 0;
+		error("Only %n lines are shown", &parg);
+	}
+#else
+	jump_back(n);
+#endif
+}
+
 /*
  * Repaint the screen.
  */
@@ -308,7 +341,9 @@ public void jump_loc(POSITION pos, int sline)
 		lastmark();
 		squished = FALSE;
 		screen_trashed_num(0);
+		begin_frame();
 		forw(sc_height-1, pos, TRUE, FALSE, FALSE, FALSE, sindex-nline);
+		end_frame();
 	} else
 	{
 		/*
@@ -346,6 +381,7 @@ public void jump_loc(POSITION pos, int sline)
 			}
 		}
 		lastmark();
+		begin_frame();
 		if (!top_scroll)
 			lclear();
 		else
@@ -353,5 +389,6 @@ public void jump_loc(POSITION pos, int sline)
 		screen_trashed_num(0);
 		add_back_pos(pos);
 		back(sc_height-1, pos, TRUE, FALSE, FALSE, FALSE);
+		end_frame();
 	}
 }
@@ -234,6 +234,7 @@ typedef off_t           LINENUM;
 #define MIN_LINENUM_WIDTH   7   /* Default min printing width of a line number */
 #define MAX_LINENUM_WIDTH   16  /* Max width of a line number */
 #define MAX_STATUSCOL_WIDTH 4   /* Max width of the status column */
+#define MAX_BLOCK_SIZE      1024 /* Max --block-size, in K */
 #define MAX_UTF_CHAR_LEN    6   /* Max bytes in one UTF-8 char */
 #define MAX_PRCHAR_LEN      31  /* Max chars in prchar() result */
 
@@ -382,9 +383,11 @@ typedef short POLL_EVENTS;
 #define SRCH_NO_MOVE    (1 << 2)  /* Highlight, but don't move */
 #define SRCH_INCR       (1 << 3)  /* Incremental search */
 #define SRCH_FIND_ALL   (1 << 4)  /* Find and highlight all matches */
+#define SRCH_DFA        (1 << 5)  /* Use the built-in linear-time matcher */
 #define SRCH_NO_MATCH   (1 << 8)  /* Search for non-matching lines */
 #define SRCH_PAST_EOF   (1 << 9)  /* Search past end-of-file, into next file */
 #define SRCH_FIRST_FILE (1 << 10) /* Search starting at the first file */
+#define SRCH_NO_JIT     (1 << 11) /* Don't JIT-compile the pattern (PCRE2) */
 #define SRCH_NO_REGEX   (1 << 12) /* Don't use regular expressions */
 #define SRCH_FILTER     (1 << 13) /* Search is for '&' (filter) command */
 #define SRCH_AFTER_TARGET (1 << 14) /* Start search after the target line */
@@ -649,6 +652,7 @@ typedef enum {
 #define SF_STOP             (1<<10) /* Stop signal */
 #define SF_TAGS             (1<<11) /* Tags */
 #define SF_OSC8_OPEN        (1<<12) /* OSC8 open */
+#define SF_LINEINDEX        (1<<13) /* Line number index files */
 
 #if LESSTEST
 #define LESS_DUMP_CHAR CONTROL(']')
@@ -658,6 +662,7 @@ struct mlist;
 struct loption;
 struct hilite_tree;
 struct ansi_state;
+struct dfa;
 #include "pattern.h"
 #include "xbuf.h"
 #include "funcs.h"
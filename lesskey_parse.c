@@ -66,7 +66,9 @@ static constant struct lesskey_cmdname cmdnames[] =
 	{ "forw-window",          A_F_WINDOW },
 	{ "goto-end",             A_GOEND },
 	{ "goto-end-buffered",    A_GOEND_BUF },
+	{ "goto-filtered-line",   A_GOFILTER },
 	{ "goto-line",            A_GOLINE },
+	{ "goto-match",           A_GOMATCH },
 	{ "goto-mark",            A_GOMARK },
 	{ "help",                 A_HELP },
 	{ "index-file",           A_INDEX_FILE },
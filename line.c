@@ -80,8 +80,52 @@ static constant char *osc_ansi_chars;
 static int osc_ansi_allow_count;
 static long *osc_ansi_allow;
 static lbool in_hilite;
+#if HILITE_SEARCH
+/* Chars from hl_run_start up to hl_run_end are highlighted with hl_run_attr. */
+static POSITION hl_run_start = NULL_POSITION;
+static POSITION hl_run_end;
+static int hl_run_attr;
+static POSITION line_hilite; /* Pos of last hilite in current line */
+#endif
 static lbool clear_after_line;
 
+/*
+ * Cache of recently formatted lines.
+ * Formatting a line (decoding UTF-8, parsing ANSI sequences,
+ * looking up highlights) costs much more than copying the result,
+ * and scrolling back and forth formats the same lines over and over.
+ */
+#define LINE_CACHE_SIZE  256    /* Must be a power of 2 */
+#define LINE_CACHE_MAX   16384  /* Don't cache lines longer than this */
+
+struct cached_line {
+	lbool used;
+	POSITION pos;           /* Position the line was requested at */
+	int how;                /* Caller's description of the request */
+	int width;              /* Screen width when it was formatted */
+	int shift;              /* Horizontal shift when it was formatted */
+	int wrap;               /* Terminal auto_wrap when it was formatted */
+	POSITION new_pos;       /* Caller's results */
+	POSITION linepos;
+	int info;
+	char *buf;              /* Copy of linebuf */
+	int *attr;
+	size_t size;            /* Allocated size of buf and attr */
+	size_t print;
+	size_t end;
+	size_t prev_end;
+	char pfx[MAX_PFX_WIDTH];
+	int pfx_attr[MAX_PFX_WIDTH];
+	size_t pfx_end;
+	POSITION line_pos;
+	int ff_starts_line;
+	lbool clear_after_line;
+#if HILITE_SEARCH
+	POSITION hilite;        /* Pos of last hilite in the line */
+#endif
+};
+static struct cached_line line_cache[LINE_CACHE_SIZE];
+
 static int attr_swidth(int a);
 static int attr_ewidth(int a);
 static int do_append(LWCHAR ch, constant char *rep, POSITION pos);
@@ -311,6 +355,10 @@ public void prewind(lbool contig)
 	is_null_line = FALSE;
 	pendc = '\0';
 	in_hilite = FALSE;
+#if HILITE_SEARCH
+	hl_run_start = NULL_POSITION;
+	line_hilite = NULL_POSITION;
+#endif
 	ansi_in_line = FALSE;
 	ff_starts_line = -1;
 	hlink_in_line = FALSE;
@@ -856,13 +904,18 @@ static int store_char(LWCHAR ch, int a, constant char *rep, POSITION pos)
 
 #if HILITE_SEARCH
 	{
-		int matches;
 		int resend_last = 0;
 		int hl_attr = 0;
 
 		if (pos != NULL_POSITION && a != AT_ANSI)
 		{
-			hl_attr = is_hilited_attr(pos, pos+1, 0, &matches);
+			if (hl_run_start == NULL_POSITION || pos < hl_run_start ||
+			    (hl_run_end != NULL_POSITION && pos >= hl_run_end))
+			{
+				hl_run_attr = hilited_run_attr(pos, &hl_run_end);
+				hl_run_start = pos;
+			}
+			hl_attr = hl_run_attr;
 			if (hl_attr == 0 && status_line)
 				hl_attr = line_mark_attr;
 		}
@@ -873,6 +926,8 @@ static int store_char(LWCHAR ch, int a, constant char *rep, POSITION pos)
 			 * Override the attribute passed in.
 			 */
 			a |= hl_attr;
+			if (pos != NULL_POSITION && (line_hilite == NULL_POSITION || pos > line_hilite))
+				line_hilite = pos;
 			if (highest_hilite != NULL_POSITION && pos != NULL_POSITION && pos > highest_hilite)
 				highest_hilite = pos;
 			in_hilite = TRUE;
@@ -1701,6 +1756,112 @@ public void null_line(void)
 	cshift = 0;
 }
 
+static struct cached_line * line_cache_entry(POSITION pos, int how)
+{
+	unsigned long h = (unsigned long) pos;
+	h ^= (h >> 7) ^ (unsigned long) how;
+	return &line_cache[h & (LINE_CACHE_SIZE-1)];
+}
+
+/*
+ * Load the line buffer from the line cache.
+ * pos and how describe the request for the line, as passed
+ * to cache_line when the line was formatted.
+ * Return FALSE if the line is not in the cache.
+ */
+public lbool get_cached_line(POSITION pos, int how, POSITION *p_new_pos, POSITION *p_linepos, int *p_info)
+{
+	struct cached_line *cl = line_cache_entry(pos, how);
+
+	if (!cl->used || cl->pos != pos || cl->how != how ||
+	    cl->width != sc_width || cl->shift != hshift || cl->wrap != auto_wrap)
+		return (FALSE);
+	while (size_linebuf <= cl->end)
+	{
+		if (expand_linebuf())
+			return (FALSE);
+	}
+	memcpy(linebuf.buf, cl->buf, (cl->end + 1) * sizeof(char));
+	memcpy(linebuf.attr, cl->attr, (cl->end + 1) * sizeof(int));
+	linebuf.print = cl->print;
+	linebuf.end = cl->end;
+	linebuf.prev_end = cl->prev_end;
+	memcpy(linebuf.pfx, cl->pfx, cl->pfx_end * sizeof(char));
+	memcpy(linebuf.pfx_attr, cl->pfx_attr, cl->pfx_end * sizeof(int));
+	linebuf.pfx_end = cl->pfx_end;
+	line_pos = cl->line_pos;
+	ff_starts_line = cl->ff_starts_line;
+	clear_after_line = cl->clear_after_line;
+	is_null_line = FALSE;
+#if HILITE_SEARCH
+	/* Note the hilites as if the line had been formatted again. */
+	line_hilite = cl->hilite;
+	if (highest_hilite != NULL_POSITION && line_hilite != NULL_POSITION && line_hilite > highest_hilite)
+		highest_hilite = line_hilite;
+#endif
+	*p_new_pos = cl->new_pos;
+	*p_linepos = cl->linepos;
+	*p_info = cl->info;
+	return (TRUE);
+}
+
+/*
+ * Save the line which has just been formatted in the line cache.
+ */
+public void cache_line(POSITION pos, int how, POSITION new_pos, POSITION linepos, int info)
+{
+	struct cached_line *cl = line_cache_entry(pos, how);
+
+	if (is_null_line || linebuf.end >= LINE_CACHE_MAX)
+		return;
+	if (cl->size <= linebuf.end)
+	{
+		size_t size = (cl->size == 0) ? LINEBUF_SIZE : cl->size;
+		while (size <= linebuf.end)
+			size *= 2;
+		free(cl->buf);
+		free(cl->attr);
+		cl->buf = (char *) ecalloc(size, sizeof(char));
+		cl->attr = (int *) ecalloc(size, sizeof(int));
+		cl->size = size;
+	}
+	memcpy(cl->buf, linebuf.buf, (linebuf.end + 1) * sizeof(char));
+	memcpy(cl->attr, linebuf.attr, (linebuf.end + 1) * sizeof(int));
+	cl->print = linebuf.print;
+	cl->end = linebuf.end;
+	cl->prev_end = linebuf.prev_end;
+	memcpy(cl->pfx, linebuf.pfx, linebuf.pfx_end * sizeof(char));
+	memcpy(cl->pfx_attr, linebuf.pfx_attr, linebuf.pfx_end * sizeof(int));
+	cl->pfx_end = linebuf.pfx_end;
+	cl->line_pos = line_pos;
+	cl->ff_starts_line = ff_starts_line;
+	cl->clear_after_line = clear_after_line;
+#if HILITE_SEARCH
+	cl->hilite = line_hilite;
+#endif
+	cl->pos = pos;
+	cl->how = how;
+	cl->width = sc_width;
+	cl->shift = hshift;
+	cl->wrap = auto_wrap;
+	cl->new_pos = new_pos;
+	cl->linepos = linepos;
+	cl->info = info;
+	cl->used = TRUE;
+}
+
+/*
+ * Discard the line cache.
+ * Called whenever something changes how lines are displayed.
+ */
+public void clr_line_cache(void)
+{
+	int i;
+
+	for (i = 0;  i < LINE_CACHE_SIZE;  i++)
+		line_cache[i].used = FALSE;
+}
+
 /*
  * Analogous to forw_line(), but deals with "raw lines":
  * lines which are not split for screen width.
@@ -1709,23 +1870,30 @@ public void null_line(void)
 public POSITION forw_raw_line_len(POSITION curr_pos, size_t read_len, constant char **linep, size_t *line_lenp)
 {
 	size_t n;
-	int c;
+	size_t len;
+	size_t seg;
+	constant unsigned char *span;
+	constant unsigned char *nl;
+	lbool full = FALSE;
 	POSITION new_pos;
 
 	if (curr_pos == NULL_POSITION || ch_seek(curr_pos) ||
-		(c = ch_forw_get()) == EOI)
+		(span = ch_forw_span(&len)) == NULL)
 		return (NULL_POSITION);
 
 	set_line_contig_pos(NULL_POSITION);
 	n = 0;
 	for (;;)
 	{
-		if (c == '\n' || c == EOI || ABORT_SIGS())
-		{
-			new_pos = ch_tell();
-			break;
-		}
-		if (n >= size_linebuf-1)
+		/*
+		 * Copy chars up to the newline (or the end of
+		 * the span) into linebuf in one piece.
+		 */
+		if (read_len != size_t_null && read_len > 0 && len > read_len - n)
+			len = read_len - n;
+		nl = (constant unsigned char *) memchr(span, '\n', len);
+		seg = (nl != NULL) ? ptr_diff(nl, span) : len;
+		while (n + seg >= size_linebuf)
 		{
 			if (expand_linebuf())
 			{
@@ -1733,17 +1901,28 @@ public POSITION forw_raw_line_len(POSITION curr_pos, size_t read_len, constant c
 				 * Overflowed the input buffer.
 				 * Pretend the line ended here.
 				 */
-				new_pos = ch_tell() - 1;
+				seg = size_linebuf - 1 - n;
+				nl = NULL;
+				full = TRUE;
 				break;
 			}
 		}
-		linebuf.buf[n++] = (char) c;
-		if (read_len != size_t_null && read_len > 0 && n >= read_len)
+		memcpy(linebuf.buf + n, span, seg);
+		n += seg;
+		if (nl != NULL)
+		{
+			/* Skip the newline too. */
+			ch_forw_skip(seg + 1);
+			new_pos = ch_tell();
+			break;
+		}
+		ch_forw_skip(seg);
+		if (full || (read_len != size_t_null && read_len > 0 && n >= read_len) ||
+		    ABORT_SIGS() || (span = ch_forw_span(&len)) == NULL)
 		{
 			new_pos = ch_tell();
 			break;
 		}
-		c = ch_forw_get();
 	}
 	linebuf.buf[n] = '\0';
 	if (linep != NULL)
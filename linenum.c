@@ -18,99 +18,169 @@
  * if input is a long pipe).
  *
  * So we use the function add_lnum to cache line numbers.
- * We try to be very clever and keep only the more interesting
- * line numbers when we run out of space in our table.  A line
- * number is more interesting than another when it is far from
- * other line numbers.   For example, we'd rather keep lines
- * 100,200,300 than 100,101,300.  200 is more interesting than
- * 101 because 101 can be derived very cheaply from 100, while
- * 200 is more expensive to derive from 100.
+ * The cached line numbers are kept in a table sorted by position,
+ * which is searched by binary search.  We keep at most one line 
+ * number in each "gap" bytes of the file, since counting newlines 
+ * across a gap is cheap.  The table grows as needed, but if it gets 
+ * too big, we double the gap and discard every other entry.
  *
  * The function currline() returns the line number of a given
  * position in the file.  As a side effect, it calls add_lnum
  * to cache the line number.  Therefore currline is occasionally
  * called to make sure we cache line numbers often enough.
+ *
+ * If the --index-lines option is set, index_linenums is called 
+ * repeatedly while we are waiting for the user to type a command.
+ * Each call counts lines through the next piece of the file,
+ * so the table gradually fills in from the start of the file to the end.
  */
 
 #include "less.h"
+#if HAVE_STAT
+#include <sys/stat.h>
+#endif
 
 /*
  * Structure to keep track of a line number and the associated file position.
- * A doubly-linked circular list of line numbers is kept ordered by line number.
  */
 struct linenum_info
 {
-	struct linenum_info *next;      /* Link to next in the list */
-	struct linenum_info *prev;      /* Line to previous in the list */
 	POSITION pos;                   /* File position */
-	POSITION gap;                   /* Gap between prev and next */
 	LINENUM line;                   /* Line number */
 };
+
+#define LONGTIME        (2)             /* In seconds */
+#define LINENUM_GAP     (16*1024)       /* Initial min gap between entries */
+#define LINENUM_MAX     (1024*1024)     /* Max entries before thinning */
+#if LESSTEST
+/* Small pieces, so that the test files are counted in several steps. */
+#define INDEX_CHUNK     256
+#else
+#define INDEX_CHUNK     (1024*1024)     /* Bytes counted per index_linenums call */
+#endif
+
 /*
- * "gap" needs some explanation: the gap of any particular line number
- * is the distance between the previous one and the next one in the list.
- * ("Distance" means difference in file position.)  In other words, the
- * gap of a line number is the gap which would be introduced if this
- * line number were deleted.  It is used to decide which one to replace
- * when we have a new one to insert and the table is full.
+ * The table of line numbers, sorted by position (and so by line number).
+ * Entry 0 is always line 1 at position 0.
  */
+static struct linenum_info *lntable = NULL;
+static size_t lntable_size = 0;         /* Number of entries allocated */
+static size_t lntable_count = 0;        /* Number of entries in use */
+static POSITION lntable_gap = LINENUM_GAP;
+static lbool linenum_modified = FALSE;  /* Entries added since index loaded */
 
-#define LONGTIME        (2)             /* In seconds */
+/*
+ * The result of the last lookup, which may be closer than any entry
+ * in the table.  Lines are often looked up one after another.
+ * A line number of 0 means there is none.
+ */
+static struct linenum_info lnum_recent;
 
-static struct linenum_info anchor;      /* Anchor of the list */
-static struct linenum_info *freelist;   /* Anchor of the unused entries */
-static struct linenum_info pool[LINENUM_POOL]; /* The pool itself */
-static struct linenum_info *spare;      /* We always keep one spare entry */
+/*
+ * Progress of index_linenums: lines have been counted up to
+ * index_pos, which is the start of line number index_line.
+ */
+static POSITION index_pos;
+static LINENUM index_line;
+static lbool index_done;
 public lbool scanning_eof = FALSE;
 
 extern int linenums;
+extern int index_lines;
 extern int sigs;
 extern int sc_height;
 extern int header_lines;
 extern int nonum_headers;
 extern POSITION header_start_pos;
+extern IFILE curr_ifile;
 
 /*
  * Initialize the line number structures.
  */
 public void clr_linenum(void)
 {
-	struct linenum_info *p;
+	if (lntable == NULL)
+	{
+		lntable_size = LINENUM_POOL;
+		lntable = (struct linenum_info *) ecalloc(lntable_size, sizeof(struct linenum_info));
+	}
+	lntable[0].pos = (POSITION)0;
+	lntable[0].line = 1;
+	lntable_count = 1;
+	lntable_gap = LINENUM_GAP;
+	linenum_modified = FALSE;
+	lnum_recent.line = 0;
+	index_pos = (POSITION)0;
+	index_line = 1;
+	index_done = FALSE;
+}
 
-	/*
-	 * Put all the entries on the free list.
-	 * Leave one for the "spare".
-	 */
-	for (p = pool;  p < &pool[LINENUM_POOL-2];  p++)
-		p->next = p+1;
-	pool[LINENUM_POOL-2].next = NULL;
-	freelist = pool;
+/*
+ * Return the index of the last entry whose position is <= pos.
+ */
+static size_t lnum_index_pos(POSITION pos)
+{
+	size_t lo = 0;
+	size_t hi = lntable_count;
 
-	spare = &pool[LINENUM_POOL-1];
+	/* lntable[lo].pos <= pos < lntable[hi].pos */
+	while (hi - lo > 1)
+	{
+		size_t mid = lo + (hi - lo) / 2;
+		if (lntable[mid].pos <= pos)
+			lo = mid;
+		else
+			hi = mid;
+	}
+	return (lo);
+}
 
-	/*
-	 * Initialize the anchor.
-	 */
-	anchor.next = anchor.prev = &anchor;
-	anchor.gap = 0;
-	anchor.pos = (POSITION)0;
-	anchor.line = 1;
+/*
+ * Return the index of the last entry whose line number is <= linenum.
+ */
+static size_t lnum_index_line(LINENUM linenum)
+{
+	size_t lo = 0;
+	size_t hi = lntable_count;
+
+	while (hi - lo > 1)
+	{
+		size_t mid = lo + (hi - lo) / 2;
+		if (lntable[mid].line <= linenum)
+			lo = mid;
+		else
+			hi = mid;
+	}
+	return (lo);
 }
 
 /*
- * Calculate the gap for an entry.
+ * The table is full.  Either make it bigger, or if it's already
+ * as big as we allow, double the gap and discard every other entry.
  */
-static void calcgap(struct linenum_info *p)
+static void grow_lntable(void)
 {
-	/*
-	 * Don't bother to compute a gap for the anchor.
-	 * Also don't compute a gap for the last one in the list.
-	 * The gap for that last one should be considered infinite,
-	 * but we never look at it anyway.
-	 */
-	if (p == &anchor || p->next == &anchor)
-		return;
-	p->gap = p->next->pos - p->prev->pos;
+	struct linenum_info *new_table;
+	size_t new_size;
+	size_t i, j;
+
+	if (lntable_size < LINENUM_MAX)
+	{
+		new_size = lntable_size * 2;
+		new_table = (struct linenum_info *) calloc(new_size, sizeof(struct linenum_info));
+		if (new_table != NULL)
+		{
+			memcpy(new_table, lntable, lntable_count * sizeof(struct linenum_info));
+			free(lntable);
+			lntable = new_table;
+			lntable_size = new_size;
+			return;
+		}
+	}
+	lntable_gap *= 2;
+	for (i = j = 1;  i < lntable_count;  i += 2)
+		lntable[j++] = lntable[i];
+	lntable_count = j;
 }
 
 /*
@@ -120,83 +190,30 @@ static void calcgap(struct linenum_info *p)
  */
 public void add_lnum(LINENUM linenum, POSITION pos)
 {
-	struct linenum_info *p;
-	struct linenum_info *new;
-	struct linenum_info *nextp;
-	struct linenum_info *prevp;
-	POSITION mingap;
+	size_t i;
 
 	/*
-	 * Find the proper place in the list for the new one.
-	 * The entries are sorted by position.
+	 * Find the proper place in the table for the new one.
+	 * Don't add it if it's too close to one we already have.
 	 */
-	for (p = anchor.next;  p != &anchor && p->pos < pos;  p = p->next)
-		if (p->line == linenum)
-			/* We already have this one. */
-			return;
-	nextp = p;
-	prevp = p->prev;
-
-	if (freelist != NULL)
-	{
-		/*
-		 * We still have free (unused) entries.
-		 * Use one of them.
-		 */
-		new = freelist;
-		freelist = freelist->next;
-	} else
-	{
-		/*
-		 * No free entries.
-		 * Use the "spare" entry.
-		 */
-		new = spare;
-		spare = NULL;
-	}
-
-	/*
-	 * Fill in the fields of the new entry,
-	 * and insert it into the proper place in the list.
-	 */
-	new->next = nextp;
-	new->prev = prevp;
-	new->pos = pos;
-	new->line = linenum;
-
-	nextp->prev = new;
-	prevp->next = new;
-
-	/*
-	 * Recalculate gaps for the new entry and the neighboring entries.
-	 */
-	calcgap(new);
-	calcgap(nextp);
-	calcgap(prevp);
-
-	if (spare == NULL)
+	i = lnum_index_pos(pos);
+	if (pos - lntable[i].pos < lntable_gap)
+		return;
+	if (i+1 < lntable_count && lntable[i+1].pos - pos < lntable_gap)
+		return;
+	if (lntable_count >= lntable_size)
 	{
-		/*
-		 * We have used the spare entry.
-		 * Scan the list to find the one with the smallest
-		 * gap, take it out and make it the spare.
-		 * We should never remove the last one, so stop when
-		 * we get to p->next == &anchor.  This also avoids
-		 * looking at the gap of the last one, which is
-		 * not computed by calcgap.
-		 */
-		mingap = anchor.next->gap;
-		for (p = anchor.next;  p->next != &anchor;  p = p->next)
-		{
-			if (p->gap <= mingap)
-			{
-				spare = p;
-				mingap = p->gap;
-			}
-		}
-		spare->next->prev = spare->prev;
-		spare->prev->next = spare->next;
+		grow_lntable();
+		i = lnum_index_pos(pos);
+		if (pos - lntable[i].pos < lntable_gap)
+			return;
 	}
+	i++;
+	memmove(&lntable[i+1], &lntable[i], (lntable_count - i) * sizeof(struct linenum_info));
+	lntable[i].pos = pos;
+	lntable[i].line = linenum;
+	lntable_count++;
+	linenum_modified = TRUE;
 }
 
 /*
@@ -264,13 +281,93 @@ static void abort_delayed_msg(struct delayed_msg *dmsg)
 	error("Line numbers turned off", NULL_PARG);
 }
 
+/*
+ * Move forward from pos, which must be the start of line number linenum,
+ * one line at a time, until reaching a line which starts at or
+ * after endpos, or until maxlines lines have been passed.
+ * A endpos of NULL_POSITION or a maxlines of -1 means no limit.
+ * Line numbers are cached as we go, so the table is filled in 
+ * as the file is read.
+ * This is equivalent to calling forw_raw_line repeatedly, but 
+ * uses memchr to find each newline in the file buffers, 
+ * rather than copying each line into the line buffer.
+ * Set *plines to the number of lines passed, and return the position
+ * of the line reached, or NULL_POSITION if we hit end of file first
+ * or the scan is interrupted.
+ */
+static POSITION forw_lines(POSITION pos, LINENUM linenum, POSITION endpos, LINENUM maxlines, LINENUM *plines, struct delayed_msg *dmsg)
+{
+	constant unsigned char *span;
+	constant unsigned char *nl;
+	size_t len;
+	LINENUM nlines = 0;
+	lbool at_linestart = TRUE;
+	POSITION lastpos = pos;
+
+	*plines = 0;
+	if (ch_seek(pos))
+		return (NULL_POSITION);
+	while ((endpos == NULL_POSITION || pos < endpos) && 
+	       (maxlines < 0 || nlines < maxlines))
+	{
+		span = ch_forw_span(&len);
+		if (span == NULL)
+		{
+			/*
+			 * End of file.  A last line with no 
+			 * newline at the end still counts as a line.
+			 */
+			if (at_linestart)
+			{
+				pos = NULL_POSITION;
+				break;
+			}
+			at_linestart = TRUE;
+			nlines++;
+			pos = ch_tell();
+			continue;
+		}
+		nl = (constant unsigned char *) memchr(span, '\n', len);
+		if (nl == NULL)
+		{
+			ch_forw_skip(len);
+			at_linestart = FALSE;
+		} else
+		{
+			ch_forw_skip(ptr_diff(nl, span) + 1);
+			at_linestart = TRUE;
+			nlines++;
+			pos = ch_tell();
+			if (pos - lastpos >= lntable_gap)
+			{
+				add_lnum(linenum + nlines, pos);
+				lastpos = pos;
+			}
+			if (dmsg != NULL)
+				delayed_msg(dmsg);
+		}
+		/*
+		 * Allow a signal to abort this loop.
+		 */
+		if (ABORT_SIGS())
+		{
+			pos = NULL_POSITION;
+			break;
+		}
+	}
+	*plines = nlines;
+	return (pos);
+}
+
 /*
  * Find the line number associated with a given position.
  * Return 0 if we can't figure it out.
  */
 public LINENUM find_linenum(POSITION pos)
 {
-	struct linenum_info *p;
+	struct linenum_info p;
+	struct linenum_info np;
+	size_t i;
 	LINENUM linenum;
 	POSITION cpos;
 	struct delayed_msg dmsg;
@@ -292,13 +389,29 @@ public LINENUM find_linenum(POSITION pos)
 		return (1);
 
 	/*
-	 * Find the entry nearest to the position we want.
+	 * Find the entries on either side of the position we want.
 	 */
-	for (p = anchor.next;  p != &anchor && p->pos < pos;  p = p->next)
-		continue;
-	if (p->pos == pos)
+	i = lnum_index_pos(pos);
+	p = lntable[i];
+	if (p.pos == pos)
 		/* Found it exactly. */
-		return (p->line);
+		return (p.line);
+	if (i+1 < lntable_count)
+		np = lntable[i+1];
+	else
+	{
+		np.pos = NULL_POSITION;
+		np.line = 0;
+	}
+	if (lnum_recent.line != 0)
+	{
+		if (lnum_recent.pos == pos)
+			return (lnum_recent.line);
+		if (lnum_recent.pos > p.pos && lnum_recent.pos < pos)
+			p = lnum_recent;
+		else if (lnum_recent.pos > pos && (np.pos == NULL_POSITION || lnum_recent.pos < np.pos))
+			np = lnum_recent;
+	}
 
 	/*
 	 * This is the (possibly) time-consuming part.
@@ -312,32 +425,27 @@ public LINENUM find_linenum(POSITION pos)
 	 * traversing fewer bytes in the file.
 	 */
 	start_delayed_msg(&dmsg, longloopmessage);
-	if (p == &anchor || pos - p->prev->pos < p->pos - pos)
+	if (np.pos == NULL_POSITION || pos - p.pos < np.pos - pos)
 	{
 		/*
 		 * Go forward.
 		 */
-		p = p->prev;
-		if (ch_seek(p->pos))
+		LINENUM nlines;
+
+		cpos = forw_lines(p.pos, p.line, pos, -1, &nlines, &dmsg);
+		if (ABORT_SIGS()) {
+			abort_delayed_msg(&dmsg);
 			return (0);
-		for (linenum = p->line, cpos = p->pos;  cpos < pos;  linenum++)
-		{
-			/*
-			 * Allow a signal to abort this loop.
-			 */
-			cpos = forw_raw_line(cpos, NULL, NULL);
-			if (ABORT_SIGS()) {
-				abort_delayed_msg(&dmsg);
-				return (0);
-			}
-			if (cpos == NULL_POSITION)
-				return (0);
-			delayed_msg(&dmsg);
 		}
+		if (cpos == NULL_POSITION)
+			return (0);
+		linenum = p.line + nlines;
 		/*
 		 * We might as well cache it.
 		 */
 		add_lnum(linenum, cpos);
+		lnum_recent.line = linenum;
+		lnum_recent.pos = cpos;
 		/*
 		 * If the given position is not at the start of a line,
 		 * make sure we return the correct line number.
@@ -349,9 +457,10 @@ public LINENUM find_linenum(POSITION pos)
 		/*
 		 * Go backward.
 		 */
-		if (ch_seek(p->pos))
+		p = np;
+		if (ch_seek(p.pos))
 			return (0);
-		for (linenum = p->line, cpos = p->pos;  cpos > pos;  linenum--)
+		for (linenum = p.line, cpos = p.pos;  cpos > pos;  linenum--)
 		{
 			/*
 			 * Allow a signal to abort this loop.
@@ -369,6 +478,8 @@ public LINENUM find_linenum(POSITION pos)
 		 * We might as well cache it.
 		 */
 		add_lnum(linenum, cpos);
+		lnum_recent.line = linenum;
+		lnum_recent.pos = cpos;
 	}
 	return (linenum);
 }
@@ -379,7 +490,9 @@ public LINENUM find_linenum(POSITION pos)
  */
 public POSITION find_pos(LINENUM linenum)
 {
-	struct linenum_info *p;
+	struct linenum_info p;
+	struct linenum_info np;
+	size_t i;
 	POSITION cpos;
 	LINENUM clinenum;
 
@@ -390,41 +503,50 @@ public POSITION find_pos(LINENUM linenum)
 		return (ch_zero());
 
 	/*
-	 * Find the entry nearest to the line number we want.
+	 * Find the entries on either side of the line number we want.
 	 */
-	for (p = anchor.next;  p != &anchor && p->line < linenum;  p = p->next)
-		continue;
-	if (p->line == linenum)
+	i = lnum_index_line(linenum);
+	p = lntable[i];
+	if (p.line == linenum)
 		/* Found it exactly. */
-		return (p->pos);
+		return (p.pos);
+	if (i+1 < lntable_count)
+		np = lntable[i+1];
+	else
+	{
+		np.pos = NULL_POSITION;
+		np.line = 0;
+	}
+	if (lnum_recent.line != 0)
+	{
+		if (lnum_recent.line == linenum)
+			return (lnum_recent.pos);
+		if (lnum_recent.line > p.line && lnum_recent.line < linenum)
+			p = lnum_recent;
+		else if (lnum_recent.line > linenum && (np.pos == NULL_POSITION || lnum_recent.line < np.line))
+			np = lnum_recent;
+	}
 
-	if (p == &anchor || linenum - p->prev->line < p->line - linenum)
+	if (np.pos == NULL_POSITION || linenum - p.line < np.line - linenum)
 	{
 		/*
 		 * Go forward.
 		 */
-		p = p->prev;
-		if (ch_seek(p->pos))
+		LINENUM nlines;
+
+		cpos = forw_lines(p.pos, p.line, NULL_POSITION, linenum - p.line, &nlines, NULL);
+		if (cpos == NULL_POSITION)
 			return (NULL_POSITION);
-		for (clinenum = p->line, cpos = p->pos;  clinenum < linenum;  clinenum++)
-		{
-			/*
-			 * Allow a signal to abort this loop.
-			 */
-			cpos = forw_raw_line(cpos, NULL, NULL);
-			if (ABORT_SIGS())
-				return (NULL_POSITION);
-			if (cpos == NULL_POSITION)
-				return (NULL_POSITION);
-		}
+		clinenum = p.line + nlines;
 	} else
 	{
 		/*
 		 * Go backward.
 		 */
-		if (ch_seek(p->pos))
+		p = np;
+		if (ch_seek(p.pos))
 			return (NULL_POSITION);
-		for (clinenum = p->line, cpos = p->pos;  clinenum > linenum;  clinenum--)
+		for (clinenum = p.line, cpos = p.pos;  clinenum > linenum;  clinenum--)
 		{
 			/*
 			 * Allow a signal to abort this loop.
@@ -440,6 +562,8 @@ public POSITION find_pos(LINENUM linenum)
 	 * We might as well cache it.
 	 */
 	add_lnum(clinenum, cpos);
+	lnum_recent.line = clinenum;
+	lnum_recent.pos = cpos;
 	return (cpos);
 }
 
@@ -476,8 +600,7 @@ static void detlenmessage(void)
  */
 public void scan_eof(void)
 {
-	POSITION pos = ch_zero();
-	LINENUM linenum = 0;
+	LINENUM nlines;
 	struct delayed_msg dmsg;
 
 	if (ch_seek(0))
@@ -488,20 +611,82 @@ public void scan_eof(void)
 	 */
 	start_delayed_msg(&dmsg, detlenmessage);
 	scanning_eof = TRUE;
-	while (pos != NULL_POSITION)
+	(void) forw_lines(ch_zero(), 1, NULL_POSITION, -1, &nlines, &dmsg);
+	if (ABORT_SIGS())
+		abort_delayed_msg(&dmsg);
+	scanning_eof = FALSE;
+}
+
+/*
+ * Is index_linenums still counting the lines in the current file?
+ */
+public lbool indexing_linenums(void)
+{
+	if (!index_lines || !linenums || index_done)
+		return (FALSE);
+	if ((ch_getflags() & (CH_CANSEEK|CH_HELPFILE)) != CH_CANSEEK)
+		return (FALSE);
+	return (TRUE);
+}
+
+/*
+ * Resume from the last cached entry if something else
+ * (a jump to a line number, say) has already counted past us.
+ */
+static void index_catchup(void)
+{
+	struct linenum_info *p = &lntable[lntable_count-1];
+
+	if (p->pos > index_pos)
 	{
-		/* For efficiency, only add one every 256 line numbers. */
-		if ((linenum++ % 256) == 0)
-			add_lnum(linenum, pos);
-		pos = forw_raw_line(pos, NULL, NULL);
-		if (ABORT_SIGS())
-		{
-			abort_delayed_msg(&dmsg);
-			break;
-		}
-		delayed_msg(&dmsg);
+		index_pos = p->pos;
+		index_line = p->line;
 	}
-	scanning_eof = FALSE;
+}
+
+/*
+ * Count the lines in the next piece of the current file.
+ * Return FALSE when there is nothing more to count.
+ */
+public lbool index_linenums(void)
+{
+	POSITION pos;
+	LINENUM nlines;
+
+	if (!indexing_linenums())
+		return (FALSE);
+	index_catchup();
+	pos = forw_lines(index_pos, index_line, index_pos + INDEX_CHUNK, -1, &nlines, NULL);
+	if (ABORT_SIGS())
+		return (FALSE);
+	index_line += nlines;
+	if (pos == NULL_POSITION)
+	{
+		/* Reached end of file. */
+		index_done = TRUE;
+		return (FALSE);
+	}
+	index_pos = pos;
+	add_lnum(index_line, index_pos);
+	return (TRUE);
+}
+
+/*
+ * If index_linenums has not yet counted most of the current file,
+ * return a line number which is known to be in the file.
+ * Otherwise return 0, meaning the caller may count the lines itself.
+ */
+public LINENUM index_linenums_partial(void)
+{
+	POSITION len;
+
+	if (!indexing_linenums())
+		return (0);
+	index_catchup();
+	len = ch_length();
+	if (len == NULL_POSITION || len - index_pos <= INDEX_CHUNK)
+		return (0);
+	return (index_line);
 }
 
 /*
@@ -521,3 +706,226 @@ public LINENUM vlinenum(LINENUM linenum)
 	}
 	return linenum;
 }
+
+#if HAVE_STAT_INO
+/*
+ * Line number index files.
+ * If $LESSLINEINDEX names a directory, the cached line numbers for
+ * each regular file are saved in that directory when the file is closed,
+ * and loaded again when the file is next opened, so that line numbers
+ * in a large file need not be recomputed each time it is viewed.
+ * The index file is named by the device and i-number of the file,
+ * and records the file's canonical name, size and modification time,
+ * and a checksum of the data at the end of the file.  The index is used
+ * only if the file is unchanged.
+ */
+#define LINENUM_INDEX_FIRST_LINE  ".less-linenum-index 1"
+#define LINENUM_INDEX_CKSUM_LEN   256
+
+/*
+ * Get the name of the index file for the current file, 
+ * and the current file's status.
+ */
+static char * linenum_index_name(less_stat_t *statbuf)
+{
+	constant char *dir;
+	constant char *filename;
+	char devbuf[INT_STRLEN_BOUND(POSITION)+2];
+	char inobuf[INT_STRLEN_BOUND(POSITION)+2];
+	char *idxname;
+	char *name;
+	size_t len;
+
+	if (!secure_allow(SF_LINEINDEX))
+		return (NULL);
+	dir = lgetenv("LESSLINEINDEX");
+	if (isnullenv(dir))
+		return (NULL);
+	if (curr_ifile == NULL_IFILE || get_altfilename(curr_ifile) != NULL)
+		return (NULL);
+	if ((ch_getflags() & (CH_CANSEEK|CH_HELPFILE|CH_POPENED|CH_NODATA|CH_NOTRUSTSIZE)) != CH_CANSEEK)
+		return (NULL);
+	filename = get_filename(curr_ifile);
+	if (less_stat(filename, statbuf) < 0 || !S_ISREG(statbuf->st_mode))
+		return (NULL);
+	postoa((POSITION) statbuf->st_dev, devbuf, 16);
+	postoa((POSITION) statbuf->st_ino, inobuf, 16);
+	len = strlen(devbuf) + strlen(inobuf) + 6;
+	idxname = (char *) ecalloc(len, sizeof(char));
+	SNPRINTF2(idxname, len, "%s-%s.lnx", devbuf, inobuf);
+	name = dirfile(dir, idxname, 0);
+	free(idxname);
+	return (name);
+}
+
+/*
+ * Compute a checksum of the data just before a given position.
+ */
+static lbool linenum_index_cksum(POSITION size, unsigned long *pcksum)
+{
+	POSITION pos;
+	unsigned long cksum = 2166136261UL;
+	int c;
+
+	pos = size - LINENUM_INDEX_CKSUM_LEN;
+	if (pos < ch_zero())
+		pos = ch_zero();
+	if (ch_seek(pos))
+		return (FALSE);
+	for (;  pos < size;  pos++)
+	{
+		if ((c = ch_forw_get()) == EOI)
+			return (FALSE);
+		cksum = ((cksum ^ (unsigned long) c) * 16777619UL) & 0xFFFFFFFFUL;
+	}
+	*pcksum = cksum;
+	return (TRUE);
+}
+
+/*
+ * Read a line from an index file into buf, without the newline.
+ */
+static lbool linenum_index_line(FILE *f, char *buf, size_t size)
+{
+	size_t len;
+
+	if (fgets(buf, (int) size, f) == NULL)
+		return (FALSE);
+	len = strlen(buf);
+	if (len == 0 || buf[len-1] != '\n')
+		return (FALSE);
+	buf[len-1] = '\0';
+	return (TRUE);
+}
+
+/*
+ * Load the saved line numbers for the current file, if any.
+ */
+public void load_linenum_index(void)
+{
+	char *name;
+	FILE *f;
+	less_stat_t statbuf;
+	char buf[1024];
+	constant char *s;
+	POSITION size;
+	POSITION mtime;
+	unsigned long cksum;
+	unsigned long fcksum;
+
+	name = linenum_index_name(&statbuf);
+	if (name == NULL)
+		return;
+	f = fopen(name, "r");
+	free(name);
+	if (f == NULL)
+		return;
+	if (!linenum_index_line(f, buf, sizeof(buf)) || 
+	    strcmp(buf, LINENUM_INDEX_FIRST_LINE) != 0)
+		goto out;
+	if (!linenum_index_line(f, buf, sizeof(buf)) ||
+	    strcmp(buf, get_real_filename(curr_ifile)) != 0)
+		goto out;
+	if (!linenum_index_line(f, buf, sizeof(buf)))
+		goto out;
+	size = lstrtoposc(buf, &s, 10);
+	mtime = (*s == ' ') ? lstrtoposc(s+1, &s, 10) : NULL_POSITION;
+	cksum = (*s == ' ') ? lstrtoulc(s+1, &s, 16) : 0;
+	if (*s != '\0' || size < 0 || mtime < 0)
+		goto out;
+	/*
+	 * Any change to the file may have moved its lines,
+	 * and a checksum of its end can't show that it was
+	 * only appended to, so use the index only if nothing changed.
+	 */
+	if ((POSITION) statbuf.st_size != size || (POSITION) statbuf.st_mtime != mtime ||
+	    !linenum_index_cksum(size, &fcksum) || fcksum != cksum)
+		goto out;
+	while (linenum_index_line(f, buf, sizeof(buf)))
+	{
+		LINENUM linenum;
+		POSITION pos;
+
+		linenum = (LINENUM) lstrtoposc(buf, &s, 10);
+		pos = (*s == ' ') ? lstrtoposc(s+1, &s, 10) : NULL_POSITION;
+		if (*s != '\0' || linenum < 1 || pos < ch_zero())
+			break;
+		if (linenum == 1)
+			/* Line 1 is always at the start of the file. */
+			continue;
+		if (pos > size)
+			break;
+		add_lnum(linenum, pos);
+	}
+	linenum_modified = FALSE;
+out:
+	fclose(f);
+}
+
+/*
+ * Save the line numbers for the current file, 
+ * if any have been found since the file was opened.
+ */
+public void save_linenum_index(void)
+{
+	char *name;
+	char *tempname;
+	FILE *f;
+	less_stat_t statbuf;
+	size_t i;
+	POSITION size;
+	unsigned long cksum;
+	char buf1[INT_STRLEN_BOUND(POSITION)+2];
+	char buf2[INT_STRLEN_BOUND(POSITION)+2];
+
+	if (!linenum_modified || lntable_count <= 1)
+		return;
+	name = linenum_index_name(&statbuf);
+	if (name == NULL)
+		return;
+	size = ch_length();
+	if (size == NULL_POSITION || size != (POSITION) statbuf.st_size ||
+	    !linenum_index_cksum(size, &cksum))
+	{
+		free(name);
+		return;
+	}
+	tempname = make_tempname(name);
+	f = fopen(tempname, "w");
+	if (f != NULL)
+	{
+		make_file_private(f);
+		fprintf(f, "%s\n%s\n", LINENUM_INDEX_FIRST_LINE, get_real_filename(curr_ifile));
+		postoa(size, buf1, 10);
+		postoa((POSITION) statbuf.st_mtime, buf2, 10);
+		fprintf(f, "%s %s %lx\n", buf1, buf2, cksum);
+		for (i = 1;  i < lntable_count;  i++)
+		{
+			if (lntable[i].pos > size)
+				break;
+			linenumtoa(lntable[i].line, buf1, 10);
+			postoa(lntable[i].pos, buf2, 10);
+			fprintf(f, "%s %s\n", buf1, buf2);
+		}
+		if (fclose(f) == 0)
+		{
+#if MSDOS_COMPILER==WIN32C
+			remove(name);
+#endif
+			rename(tempname, name);
+		} else
+			remove(tempname);
+	}
+	free(tempname);
+	free(name);
+	linenum_modified = FALSE;
+}
+#else
+public void load_linenum_index(void)
+{
+}
+
+public void save_linenum_index(void)
+{
+}
+#endif /* HAVE_STAT_INO */
@@ -182,6 +182,7 @@ static int security_feature(constant char *name, size_t len)
 		{ "glob",     SF_GLOB },
 		{ "history",  SF_HISTORY },
 		{ "lesskey",  SF_LESSKEY },
+		{ "lineindex", SF_LINEINDEX },
 		{ "lessopen", SF_LESSOPEN },
 		{ "logfile",  SF_LOGFILE },
 		{ "osc8",     SF_OSC8_OPEN },
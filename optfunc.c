@@ -29,6 +29,7 @@
 #include "position.h"
 
 extern int bufspace;
+extern int block_size;
 extern int pr_type;
 extern lbool plusoption;
 extern int swindow;
@@ -518,6 +519,30 @@ public void opt_b(int type, constant char *s)
 	}
 }
 
+/*
+ * Handler for the --block-size option.
+ */
+	/*ARGSUSED*/
+public void opt_block_size(int type, constant char *s)
+{
+	PARG parg;
+
+	switch (type)
+	{
+	case INIT:
+	case TOGGLE:
+		if (block_size < 0 || block_size > MAX_BLOCK_SIZE)
+		{
+			parg.p_int = MAX_BLOCK_SIZE;
+			error("Block size must be between 0 and %dK", &parg);
+			block_size = 0;
+		}
+		break;
+	case QUERY:
+		break;
+	}
+}
+
 /*
  * Handler for the -i option.
  */
@@ -1147,11 +1172,13 @@ public void opt_search_type(int type, constant char *s)
 		{
 			switch (*s)
 			{
+			case 'D': case 'd':                    st |= SRCH_DFA;        break;
 			case 'E': case 'e': case CONTROL('E'): st |= SRCH_PAST_EOF;   break;
 			case 'F': case 'f': case CONTROL('F'): st |= SRCH_FIRST_FILE; break;
 			case 'K': case 'k': case CONTROL('K'): st |= SRCH_NO_MOVE;    break;
 			case 'N': case 'n': case CONTROL('N'): st |= SRCH_NO_MATCH;   break;
 			case 'R': case 'r': case CONTROL('R'): st |= SRCH_NO_REGEX;   break;
+			case 'J': case 'j':                    st |= SRCH_NO_JIT;     break;
 			case 'W': case 'w': case CONTROL('W'): st |= SRCH_WRAP;       break;
 			case '-': st = 0; break;
 			case '^': break;
@@ -1170,11 +1197,13 @@ public void opt_search_type(int type, constant char *s)
 		break;
 	case QUERY:
 		bp = buf;
+		if (def_search_type & SRCH_DFA)        *bp++ = 'D'; 
 		if (def_search_type & SRCH_PAST_EOF)   *bp++ = 'E'; 
 		if (def_search_type & SRCH_FIRST_FILE) *bp++ = 'F'; 
 		if (def_search_type & SRCH_NO_MOVE)    *bp++ = 'K'; 
 		if (def_search_type & SRCH_NO_MATCH)   *bp++ = 'N'; 
 		if (def_search_type & SRCH_NO_REGEX)   *bp++ = 'R'; 
+		if (def_search_type & SRCH_NO_JIT)     *bp++ = 'J'; 
 		if (def_search_type & SRCH_WRAP)       *bp++ = 'W'; 
 		for (i = 1;  i <= NUM_SEARCH_COLORS;  i++)
 			if (def_search_type & SRCH_SUBSEARCH(i))
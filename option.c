@@ -456,6 +456,12 @@ public lbool toggle_option(struct loption *o, lbool lower, constant char *s, int
 	if (o->ofunc != NULL)
 		(*o->ofunc)((how_toggle==OPT_NO_TOGGLE) ? QUERY : TOGGLE, s);
 
+	/*
+	 * Any option may change how lines are displayed.
+	 */
+	if (how_toggle != OPT_NO_TOGGLE)
+		clr_line_cache();
+
 #if HILITE_SEARCH
 	if (how_toggle != OPT_NO_TOGGLE && (o->otype & O_HL_REPAINT))
 		chg_hilite();
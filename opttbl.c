@@ -85,6 +85,12 @@ public int match_shift;         /* Extra horizontal shift on search match */
 public int no_paste;            /* Don't accept pasted input */
 public int no_edit_warn;        /* Don't warn when editing a LESSOPENed file */
 public int stop_on_form_feed;   /* Stop scrolling on a line starting with form feed */
+public int use_mmap;            /* Map seekable files into memory */
+public int block_size;          /* Size of each buffer block (K); 0 = auto */
+public int index_lines;         /* Count lines while waiting for input */
+public int search_threads;      /* Number of threads for forward searches */
+public int filter_count;        /* Count lines shown by filters while waiting for input */
+public int index_matches;       /* Index search matches while waiting for input */
 public long match_shift_fraction = NUM_FRAC_DENOM/2; /* 1/2 of screen width */
 public char intr_char = CONTROL('X'); /* Char to interrupt reads */
 public char *first_cmd_at_prompt = NULL; /* Command to exec before first prompt */
@@ -189,6 +195,12 @@ static struct optname proc_return_optname = { "proc-return", NULL };
 static struct optname match_shift_optname = { "match-shift", NULL };
 static struct optname first_cmd_at_prompt_optname = { "cmd", NULL };
 static struct optname autosave_optname = { "autosave", NULL };
+static struct optname use_mmap_optname = { "mmap", NULL };
+static struct optname block_size_optname = { "block-size", NULL };
+static struct optname index_lines_optname = { "index-lines", NULL };
+static struct optname search_threads_optname = { "search-threads", NULL };
+static struct optname filter_count_optname = { "filter-count", NULL };
+static struct optname index_matches_optname = { "index-matches", NULL };
 #if LESSTEST
 static struct optname ttyin_name_optname = { "tty",              NULL };
 #endif /*LESSTEST*/
@@ -769,6 +781,54 @@ static struct loption option[] =
 		O_STRING|O_INIT_HANDLER, 0, NULL, opt_autosave,
 		{ "Autosave actions: ", "s", NULL }
 	},
+	{ OLETTER_NONE, &use_mmap_optname,
+		O_BOOL, OPT_OFF, &use_mmap, NULL,
+		{
+			"Read files into buffers",
+			"Map seekable files into memory",
+			NULL
+		}
+	},
+	{ OLETTER_NONE, &index_lines_optname,
+		O_BOOL, OPT_OFF, &index_lines, NULL,
+		{
+			"Count lines only when needed",
+			"Count lines while waiting for input",
+			NULL
+		}
+	},
+	{ OLETTER_NONE, &block_size_optname,
+		O_NUMBER, 0, &block_size, opt_block_size,
+		{
+			"Buffer block size (K): ",
+			"Buffer block size: %dK (0 = automatic)",
+			NULL
+		}
+	},
+	{ OLETTER_NONE, &search_threads_optname,
+		O_NUMBER, 0, &search_threads, NULL,
+		{
+			"Search threads: ",
+			"Search threads: %d",
+			NULL
+		}
+	},
+	{ OLETTER_NONE, &filter_count_optname,
+		O_BOOL, OPT_OFF, &filter_count, NULL,
+		{
+			"Count filtered lines only when needed",
+			"Count filtered lines while waiting for input",
+			NULL
+		}
+	},
+	{ OLETTER_NONE, &index_matches_optname,
+		O_BOOL, OPT_OFF, &index_matches, NULL,
+		{
+			"Index search matches only when needed",
+			"Index search matches while waiting for input",
+			NULL
+		}
+	},
 #if LESSTEST
 	{ OLETTER_NONE, &ttyin_name_optname,
 		O_STRING|O_NO_TOGGLE, 0, NULL, opt_ttyin_name,
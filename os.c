@@ -209,6 +209,26 @@ public lbool ttyin_ready(void)
 #endif
 }
 
+/*
+ * Can ttyin_ready actually tell whether a character is available?
+ */
+public lbool ttyin_pollable(void)
+{
+#if MSDOS_COMPILER
+	return TRUE;
+#else
+#if USE_POLL
+#if LESSTEST
+	if (is_lesstest())
+		return FALSE;
+#endif /*LESSTEST*/
+	return use_poll;
+#else
+	return FALSE;
+#endif
+#endif
+}
+
 public int supports_ctrl_x(void)
 {
 #if MSDOS_COMPILER==WIN32C
@@ -369,17 +389,25 @@ start:
 #endif
 		return (READ_ERR);
 	}
-	if (fd != tty && !any_data)
-	{
-		/* We have received the first byte of data, or
-		 * read EOF on an empty file: init the terminal. */
-		term_init();
-		if (n > 0)
-			any_data = TRUE;
-	}
+	if (fd != tty)
+		got_data(n > 0);
 	return (n);
 }
 
+/*
+ * We have received data from the input file, or read EOF on an empty file.
+ * Reads from a mapped file bypass iread, so ch.c calls this too.
+ */
+public void got_data(lbool nonempty)
+{
+	if (any_data)
+		return;
+	/* This is the first byte of data (or EOF): init the terminal. */
+	term_init();
+	if (nonempty)
+		any_data = TRUE;
+}
+
 /*
  * Like open() system call, but is interruptible.
  */
@@ -72,9 +72,18 @@ public void put_line(lbool forw_scroll)
 		if (c == '\b')
 			putbs();
 		else
+		{
+			int na;
+			if (c == ' ' && gline(i+1, &na) == '\b' && gline(i+2, &na) == '\0')
+				/* The space nudges the terminal to wrap; see pdone(). */
+				shadow_wrap();
 			putchr(c);
+		}
 	}
 	at_exit();
+	if (should_clear_after_line())
+		/* The terminal wrapped after the last char; see pdone(). */
+		shadow_wrap();
 
 	if (forw_scroll && should_clear_after_line())
 		clear_eol();
@@ -474,6 +483,8 @@ public int putchr(int ch)
 	}
 #endif
 	clear_bot_if_needed();
+	if (shadow_putchr(c))
+		return (c);
 #if MSDOS_COMPILER
 	if (c == '\n' && is_tty)
 	{
@@ -496,6 +507,21 @@ public int putchr(int ch)
 	return (c);
 }
 
+/*
+ * Output a character of a control sequence which moves the cursor
+ * or changes the terminal's modes, rather than putting text on the screen.
+ */
+public int putctl(int ch)
+{
+	char c = (char) ch;
+
+	clear_bot_if_needed();
+	if (ob >= &obuf[sizeof(obuf)-1])
+		flush();
+	*ob++ = c;
+	return (c);
+}
+
 public void clear_bot_if_needed(void)
 {
 	if (!need_clr)
@@ -688,6 +714,7 @@ public void error(constant char *fmt, PARG *parg)
 		return;
 	}
 
+	flush_frame();
 	if (!oldbot)
 		squish_check();
 	at_exit();
@@ -704,12 +731,15 @@ public void error(constant char *fmt, PARG *parg)
 	clear_eol();
 
 	if (col >= sc_width)
+	{
 		/*
 		 * Printing the message has probably scrolled the screen.
 		 * {{ Unless the terminal doesn't have auto margins,
 		 *    in which case we just hammered on the right margin. }}
 		 */
+		forget_screen();
 		screen_trashed();
+	}
 
 	flush();
 }
@@ -722,6 +752,7 @@ public void error(constant char *fmt, PARG *parg)
  */
 static void ierror_suffix(constant char *fmt, PARG *parg, constant char *suffix1, constant char *suffix2, constant char *suffix3)
 {
+	flush_frame();
 	at_exit();
 	clear_bot();
 	at_enter(AT_STANDOUT|AT_COLOR_ERROR);
@@ -770,7 +801,10 @@ public int query(constant char *fmt, PARG *parg)
 	{
 		lower_left();
 		if (col >= sc_width)
+		{
+			forget_screen();
 			screen_trashed();
+		}
 		flush();
 	} else
 	{
@@ -12,6 +12,7 @@
  */
 
 #include "less.h"
+#include "charset.h"
 
 extern int caseless;
 extern int is_caseless;
@@ -95,6 +96,12 @@ static int compile_pattern2(constant char *pattern, int search_type, PATTERN_TYP
 		}
 		return (-1);
 	}
+	/*
+	 * JIT-compile the pattern unless told not to.
+	 * If JIT is not available, pcre2_match just uses the interpreter.
+	 */
+	if (!(search_type & SRCH_NO_JIT))
+		(void) pcre2_jit_compile(comp, PCRE2_JIT_COMPLETE);
 	*comp_pattern = comp;
 #endif
 #if HAVE_RE_COMP
@@ -142,8 +149,9 @@ static int compile_pattern2(constant char *pattern, int search_type, PATTERN_TYP
 
 /*
  * Like compile_pattern2, but convert the pattern to lowercase if necessary.
+ * Also make the space for the pattern's match results in *comp_data.
  */
-public int compile_pattern(constant char *pattern, int search_type, int show_error, PATTERN_TYPE *comp_pattern)
+public int compile_pattern(constant char *pattern, int search_type, int show_error, PATTERN_TYPE *comp_pattern, MATCH_DATA_TYPE *comp_data)
 {
 	int result;
 
@@ -157,13 +165,32 @@ public int compile_pattern(constant char *pattern, int search_type, int show_err
 		result = compile_pattern2(cvt_pattern, search_type, comp_pattern, show_error);
 		free(cvt_pattern);
 	}
+#if HAVE_PCRE2
+	/*
+	 * The match data block is big enough for any nsp,
+	 * so it is made once and reused for every match.
+	 */
+	if (result == 0 && !(search_type & SRCH_NO_REGEX) && *comp_data == NULL)
+	{
+		*comp_data = pcre2_match_data_create(NUM_SEARCH_COLORS+1, NULL);
+		if (*comp_data == NULL)
+		{
+			if (show_error)
+				error("Cannot allocate match data", NULL_PARG);
+			return (-1);
+		}
+	}
+#else
+	(void) comp_data;
+#endif
 	return (result);
 }
 
 /*
- * Forget that we have a compiled pattern.
+ * Forget that we have a compiled pattern, and free its match data
+ * (unless data is NULL).
  */
-public void uncompile_pattern(PATTERN_TYPE *pattern)
+public void uncompile_pattern(PATTERN_TYPE *pattern, MATCH_DATA_TYPE *data)
 {
 #if HAVE_GNU_REGEX
 	if (*pattern != NULL)
@@ -190,6 +217,14 @@ public void uncompile_pattern(PATTERN_TYPE *pattern)
 	if (*pattern != NULL)
 		pcre2_code_free(*pattern);
 	*pattern = NULL;
+	if (data != NULL)
+	{
+		if (*data != NULL)
+			pcre2_match_data_free(*data);
+		*data = NULL;
+	}
+#else
+	(void) data;
 #endif
 #if HAVE_RE_COMP
 	*pattern = 0;
@@ -206,6 +241,37 @@ public void uncompile_pattern(PATTERN_TYPE *pattern)
 #endif
 }
 
+/*
+ * Compile a pattern for the built-in DFA matcher.
+ */
+public int compile_dfa_pattern(constant char *pattern, int show_error, struct dfa **comp_dfa)
+{
+	constant char *errmsg;
+	struct dfa *comp = dfa_compile(pattern, is_caseless != 0, &errmsg);
+	if (comp == NULL)
+	{
+		if (show_error)
+		{
+			PARG parg;
+			parg.p_string = errmsg;
+			error("%s", &parg);
+		}
+		return (-1);
+	}
+	uncompile_dfa_pattern(comp_dfa);
+	*comp_dfa = comp;
+	return (0);
+}
+
+/*
+ * Forget a pattern compiled for the DFA matcher.
+ */
+public void uncompile_dfa_pattern(struct dfa **comp_dfa)
+{
+	dfa_free(*comp_dfa);
+	*comp_dfa = NULL;
+}
+
 #if 0
 /*
  * Can a pattern be successfully compiled?
@@ -213,13 +279,14 @@ public void uncompile_pattern(PATTERN_TYPE *pattern)
 public int valid_pattern(char *pattern)
 {
 	PATTERN_TYPE comp_pattern;
+	MATCH_DATA_TYPE comp_data = NULL;
 	int result;
 
 	SET_NULL_PATTERN(comp_pattern);
 	result = compile_pattern2(pattern, 0, &comp_pattern, 0);
 	if (result != 0)
 		return (0);
-	uncompile_pattern(&comp_pattern);
+	uncompile_pattern(&comp_pattern, &comp_data);
 	return (1);
 }
 #endif
@@ -296,11 +363,34 @@ static int match(constant char *pattern, size_t pattern_len, constant char *buf,
  * Set sp[i] and ep[i] to the start and end of the i-th matched subpattern.
  * Subpatterns are defined by parentheses in the regex language.
  */
-static lbool match_pattern1(PATTERN_TYPE pattern, constant char *tpattern, constant char *line, size_t aline_len, size_t line_off, constant char **sp, constant char **ep, int nsp, int notbol, int search_type)
+static lbool match_pattern1(PATTERN_TYPE pattern, MATCH_DATA_TYPE data, struct dfa *dfa, constant char *tpattern, constant char *line, size_t aline_len, size_t line_off, constant char **sp, constant char **ep, int nsp, int notbol, int search_type)
 {
 	int matched;
 	int line_len = (int) aline_len; /*{{type-issue}}*/
 
+	if (dfa != NULL && !(search_type & SRCH_NO_REGEX))
+	{
+		#define DFA_OFFS (2*(NUM_SEARCH_COLORS+1))
+		ssize_t offs[DFA_OFFS];
+		int noffs = dfa_match(dfa, line, aline_len, line_off, notbol, offs, DFA_OFFS);
+		int i;
+		matched = (noffs > 0);
+		if (noffs > 2*(nsp-1))
+			noffs = 2*(nsp-1);
+		for (i = 0;  i < noffs;  i += 2)
+		{
+			if (offs[i] < 0)
+			{
+				*sp++ = *ep++ = line;
+			} else
+			{
+				*sp++ = line + offs[i];
+				*ep++ = line + offs[i+1];
+			}
+		}
+		*sp = *ep = NULL;
+		return ((search_type & SRCH_NO_MATCH) ? !matched : matched);
+	}
 #if NO_REGEX
 	search_type |= SRCH_NO_REGEX;
 #endif
@@ -391,13 +481,12 @@ static lbool match_pattern1(PATTERN_TYPE pattern, constant char *tpattern, const
 #if HAVE_PCRE2
 	{
 		int flags = (notbol) ? PCRE2_NOTBOL : 0;
-		pcre2_match_data *md = pcre2_match_data_create(nsp-1, NULL);
 		int mcount = pcre2_match(pattern, (PCRE2_SPTR)line, line_len,
-			line_off, flags, md, NULL);
+			line_off, flags, data, NULL);
 		matched = (mcount > 0);
 		if (matched)
 		{
-			PCRE2_SIZE *ovector = pcre2_get_ovector_pointer(md);
+			PCRE2_SIZE *ovector = pcre2_get_ovector_pointer(data);
 			int i;
 			int ecount = nsp-1;
 			if (ecount > mcount) ecount = mcount;
@@ -414,7 +503,6 @@ static lbool match_pattern1(PATTERN_TYPE pattern, constant char *tpattern, const
 				}
 			}
 		}
-		pcre2_match_data_free(md);
 	}
 #endif
 #if HAVE_RE_COMP
@@ -461,12 +549,16 @@ static lbool subsearch_ok(constant char **sp, constant char **ep, int search_typ
 	return TRUE;
 }
 
-public lbool match_pattern(PATTERN_TYPE pattern, constant char *tpattern, constant char *line, size_t line_len, size_t line_off, constant char **sp, constant char **ep, int nsp, int notbol, int search_type)
+/*
+ * Match a line against a pattern.
+ * If dfa is not NULL, it is used instead of the compiled pattern.
+ */
+public lbool match_pattern(PATTERN_TYPE pattern, MATCH_DATA_TYPE data, struct dfa *dfa, constant char *tpattern, constant char *line, size_t line_len, size_t line_off, constant char **sp, constant char **ep, int nsp, int notbol, int search_type)
 {
 	for (;;)
 	{
 		size_t mlen;
-		lbool matched = match_pattern1(pattern, tpattern, line, line_len, line_off, sp, ep, nsp, notbol, search_type);
+		lbool matched = match_pattern1(pattern, data, dfa, tpattern, line, line_len, line_off, sp, ep, nsp, notbol, search_type);
 		if (!matched || subsearch_ok(sp, ep, search_type))
 			return matched;
 		/* We have a match, but it does not satisfy all SUBSEARCH conditions.
@@ -481,6 +573,316 @@ public lbool match_pattern(PATTERN_TYPE pattern, constant char *tpattern, consta
 	}
 }
 
+/*
+ * Literal extraction understands the syntax of extended regular
+ * expressions (POSIX ERE and the Perl-compatible libraries).
+ */
+#if HAVE_GNU_REGEX || (HAVE_POSIX_REGCOMP && defined(REG_EXTENDED)) || HAVE_PCRE || HAVE_PCRE2
+#define LITERAL_PREFILTER 1
+#else
+#define LITERAL_PREFILTER 0
+#endif
+
+#if LITERAL_PREFILTER
+/*
+ * Skip a bracket expression; p points just after the "[".
+ * Return a pointer after the closing "]", or NULL if there is none.
+ */
+static constant char * skip_bracket(constant char *p)
+{
+	if (*p == '^')
+		p++;
+	if (*p == ']')
+		p++;
+	for (;  *p != '\0';  p++)
+	{
+		if (*p == ']')
+			return (p+1);
+		if (*p == '[' && (p[1] == ':' || p[1] == '.' || p[1] == '='))
+		{
+			/* Character class [:name:] etc. */
+			char delim = p[1];
+			for (p += 2;  *p != '\0';  p++)
+				if (p[0] == delim && p[1] == ']')
+					break;
+			if (*p == '\0')
+				return (NULL);
+			p++;
+		} else if (*p == '\\' && p[1] != '\0')
+			p++;
+	}
+	return (NULL);
+}
+
+/*
+ * Skip a parenthesized group; p points just after the "(".
+ * Return a pointer after the closing ")", or NULL if there is none.
+ */
+static constant char * skip_group(constant char *p)
+{
+	int depth = 1;
+
+	while (*p != '\0')
+	{
+		if (*p == '\\' && p[1] != '\0')
+			p += 2;
+		else if (*p == '[')
+		{
+			if ((p = skip_bracket(p+1)) == NULL)
+				return (NULL);
+		} else
+		{
+			if (*p == '(')
+				depth++;
+			else if (*p == ')' && --depth == 0)
+				return (p+1);
+			p++;
+		}
+	}
+	return (NULL);
+}
+#endif
+
+/*
+ * Find a literal string which must appear in any text matched 
+ * by a regular expression, so lines can be rejected cheaply 
+ * before running the full pattern matcher.
+ * Return the longest such string found (in allocated memory),
+ * or NULL if none could be determined.
+ * This is conservative: alternation at the top level, inline
+ * options, and escapes not listed here give no string at all,
+ * and anything else not understood just ends the current string.
+ */
+public char * pattern_literal(constant char *pattern)
+{
+#if LITERAL_PREFILTER
+	size_t plen = strlen(pattern);
+	char *run = (char *) ecalloc(plen + 1, sizeof(char));
+	char *best = (char *) ecalloc(plen + 1, sizeof(char));
+	size_t run_len = 0;
+	size_t best_len = 0;
+	size_t last_char = 0;   /* Offset in run of the last char added */
+	constant char *p = pattern;
+
+	if (strstr(pattern, "(?") != NULL || strstr(pattern, "(*") != NULL ||
+	    strstr(pattern, "\\Q") != NULL)
+		/* Options or quoting which change the meaning of what follows. */
+		p = NULL;
+	while (p != NULL && *p != '\0')
+	{
+		char c = *p;
+		lbool end_run = TRUE;
+
+		switch (c)
+		{
+		case '|':
+			/* Alternation; nothing is certain. */
+			best_len = run_len = 0;
+			p = NULL;
+			continue;
+		case '*': case '?': case '{':
+			/* The preceding char may not appear; remove it. */
+			if (run_len > 0)
+				run_len = last_char;
+			if (c == '{' && (p = strchr(p, '}')) == NULL)
+				break;
+			p++;
+			break;
+		case '+':
+		case '.': case '^': case '$': case ')':
+			p++;
+			break;
+		case '[':
+			p = skip_bracket(p+1);
+			break;
+		case '(':
+			p = skip_group(p+1);
+			break;
+		case '\\':
+			if (p[1] != '\0' && strchr(".[](){}*+?|^$\\/", p[1]) != NULL)
+			{
+				/* Escaped metacharacter is an ordinary char. */
+				last_char = run_len;
+				run[run_len++] = p[1];
+				end_run = FALSE;
+				p += 2;
+			} else if (p[1] != '\0' && strchr("bBdDsSwW<>`'AzZG", p[1]) != NULL)
+			{
+				/* \d, \b, \<, etc. */
+				p += 2;
+			} else
+			{
+				/*
+				 * Some libraries give other escapes an operand
+				 * (\x41, \cA, \g1, \k<n>, \0nn ...) which is not
+				 * literal text, so don't try to understand them.
+				 */
+				best_len = run_len = 0;
+				p = NULL;
+				continue;
+			}
+			break;
+		default:
+			/* Ordinary char; add the whole (possibly multibyte) char. */
+			last_char = run_len;
+			do
+				run[run_len++] = *p++;
+			while (utf_mode && IS_UTF8_TRAIL(*p));
+			end_run = FALSE;
+			break;
+		}
+		if (end_run)
+		{
+			/*
+			 * A quantifier may follow a char which ends the run,
+			 * but it cannot remove anything from the saved best.
+			 */
+			if (run_len > best_len)
+			{
+				memcpy(best, run, run_len);
+				best_len = run_len;
+			}
+			run_len = 0;
+		}
+	}
+	if (run_len > best_len)
+	{
+		memcpy(best, run, run_len);
+		best_len = run_len;
+	}
+	free(run);
+	if (best_len == 0)
+	{
+		free(best);
+		return (NULL);
+	}
+	best[best_len] = '\0';
+	return (best);
+#else
+	(void) pattern;
+	return (NULL);
+#endif
+}
+
+/*
+ * Block matching runs a pattern over a buffer holding many lines,
+ * with "^" and "$" matching at line boundaries and "." not matching
+ * a newline.  It is only used to find candidate lines, which are then
+ * matched normally, so a match which spans lines does no harm.
+ */
+#if (HAVE_POSIX_REGCOMP && defined(REG_NEWLINE) && defined(REG_STARTEND)) || HAVE_PCRE2
+#define BLOCK_MATCH 1
+#else
+#define BLOCK_MATCH 0
+#endif
+
+/*
+ * Compile a pattern for use by match_block.
+ * Return -1 if the pattern cannot be used for block matching.
+ */
+public int compile_block_pattern(constant char *pattern, int search_type, PATTERN_TYPE *comp_pattern, MATCH_DATA_TYPE *comp_data)
+{
+#if BLOCK_MATCH
+	/*
+	 * Don't use patterns with buffer anchors, which would match only
+	 * at the ends of the block, or options which might change that.
+	 * Also avoid backreferences, which can be slow on a large block.
+	 */
+	static constant char *unsafe[] = {
+		"\\`", "\\'", "\\A", "\\z", "\\Z", "\\G", "(?", "(*", NULL };
+	constant char **u;
+	constant char *p;
+#if HAVE_POSIX_REGCOMP
+	regex_t *comp;
+#endif
+#if HAVE_PCRE2
+	pcre2_code *comp;
+	int errcode;
+	PCRE2_SIZE erroffset;
+#endif
+
+	if (search_type & SRCH_NO_REGEX)
+		return (-1);
+	for (u = unsafe;  *u != NULL;  u++)
+		if (strstr(pattern, *u) != NULL)
+			return (-1);
+	for (p = pattern;  (p = strchr(p, '\\')) != NULL;  p += 2)
+	{
+		if (p[1] >= '1' && p[1] <= '9')
+			return (-1);
+		if (p[1] == '\0')
+			break;
+	}
+#if HAVE_POSIX_REGCOMP
+	comp = (regex_t *) ecalloc(1, sizeof(regex_t));
+	if (regcomp(comp, pattern, REGCOMP_FLAG | REG_NEWLINE | (is_caseless ? REG_ICASE : 0)))
+	{
+		free(comp);
+		return (-1);
+	}
+#endif
+#if HAVE_PCRE2
+	comp = pcre2_compile((PCRE2_SPTR)pattern, strlen(pattern),
+			((utf_mode) ? PCRE2_UTF | PCRE2_NO_UTF_CHECK : 0) |
+			(is_caseless ? PCRE2_CASELESS : 0) | PCRE2_MULTILINE,
+			&errcode, &erroffset, NULL);
+	if (comp == NULL)
+		return (-1);
+	if (!(search_type & SRCH_NO_JIT))
+		(void) pcre2_jit_compile(comp, PCRE2_JIT_COMPLETE);
+	if (*comp_data == NULL && 
+	    (*comp_data = pcre2_match_data_create(1, NULL)) == NULL)
+	{
+		pcre2_code_free(comp);
+		return (-1);
+	}
+#endif
+	uncompile_pattern(comp_pattern, NULL);
+	*comp_pattern = comp;
+	return (0);
+#else
+	(void) pattern;
+	(void) search_type;
+	(void) comp_pattern;
+	(void) comp_data;
+	return (-1);
+#endif
+}
+
+/*
+ * Match a pattern compiled by compile_block_pattern against a block
+ * of complete lines.  If there is a match, set *poff to the offset
+ * in the block of the start of the first match and return TRUE.
+ */
+public lbool match_block(PATTERN_TYPE pattern, MATCH_DATA_TYPE data, constant char *block, size_t len, size_t *poff)
+{
+#if BLOCK_MATCH
+#if HAVE_POSIX_REGCOMP
+	regmatch_t rm[1];
+	(void) data;
+	rm[0].rm_so = 0;
+	rm[0].rm_eo = (regoff_t) len;
+	if (regexec(pattern, block, 1, rm, REG_STARTEND) != 0)
+		return (FALSE);
+	*poff = (size_t) rm[0].rm_so;
+	return (TRUE);
+#endif
+#if HAVE_PCRE2
+	if (pcre2_match(pattern, (PCRE2_SPTR)block, len, 0, 0, data, NULL) <= 0)
+		return (FALSE);
+	*poff = (size_t) pcre2_get_ovector_pointer(data)[0];
+	return (TRUE);
+#endif
+#else
+	(void) pattern;
+	(void) data;
+	(void) block;
+	(void) len;
+	(void) poff;
+	return (FALSE);
+#endif
+}
+
 /*
  * Return the name of the pattern matching library.
  */
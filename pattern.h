@@ -41,6 +41,7 @@
 #include <pcre2.h>
 #define PATTERN_TYPE             pcre2_code *
 #define SET_NULL_PATTERN(name)   name = NULL
+#define MATCH_DATA_TYPE          pcre2_match_data *
 #define re_handles_caseless      TRUE
 #endif
 
@@ -78,3 +79,8 @@ extern int reg_show_error;
 #ifndef re_handles_caseless
 #define re_handles_caseless      FALSE
 #endif
+
+/* Space for match results, kept with each compiled pattern. */
+#ifndef MATCH_DATA_TYPE
+#define MATCH_DATA_TYPE          void *
+#endif
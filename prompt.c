@@ -207,6 +207,12 @@ static lbool cond(char c, int where)
 	case 'f': /* Filename known? */
 	case 'g':
 		return (strcmp(get_filename(curr_ifile), "-") != 0);
+	case 'H': /* Number of lines shown by filters known? */
+#if HILITE_SEARCH
+		return (filter_line_count(NULL) >= 0);
+#else
+		return (FALSE);
+#endif
 	case 'l': /* Line number known? */
 	case 'd': /* Same as l */
 		if (!linenums)
@@ -215,6 +221,12 @@ static lbool cond(char c, int where)
 	case 'L': /* Final line number known? */
 	case 'D': /* Final page number known? */
 		return (linenums && ch_length() != NULL_POSITION);
+	case 'M': /* Number of matching lines known? */
+#if HILITE_SEARCH
+		return (match_count(NULL) >= 0);
+#else
+		return (FALSE);
+#endif
 	case 'm': /* More than one file? */
 #if TAGS
 		return (ntags() ? (ntags() > 1) : (nifile() > 1));
@@ -232,6 +244,7 @@ static lbool cond(char c, int where)
 	case 'P': /* Percent into file (lines) known? */
 		return (currline(where) != 0 &&
 				(len = ch_length()) > 0 &&
+				index_linenums_partial() == 0 &&
 				find_linenum(len) != 0);
 	case 's': /* Size of file known? */
 	case 'B':
@@ -292,7 +305,12 @@ static void protochar(char c, int where)
 		else if (len == 0)
 			/* An empty file has no pages. */
 			ap_linenum(0);
-		else
+		else if ((linenum = index_linenums_partial()) > 0)
+		{
+			/* Still counting lines; show what we know so far. */
+			ap_linenum(PAGE_NUM(linenum));
+			ap_char('+');
+		} else
 		{
 			linenum = find_linenum(len - 1);
 			if (linenum <= 0)
@@ -317,6 +335,24 @@ static void protochar(char c, int where)
 		ap_str(s);
 		free(s);
 		break;
+	case 'H': /* Number of lines shown by filters */
+#if HILITE_SEARCH
+		{
+			lbool done;
+			linenum = filter_line_count(&done);
+			if (linenum < 0)
+				ap_quest();
+			else
+			{
+				ap_linenum(linenum);
+				if (!done)
+					ap_char('+');
+			}
+		}
+#else
+		ap_quest();
+#endif
+		break;
 	case 'i': /* Index into list of files */
 #if TAGS
 		if (ntags())
@@ -334,8 +370,16 @@ static void protochar(char c, int where)
 		break;
 	case 'L': /* Final line number */
 		len = ch_length();
-		if (len == NULL_POSITION || len == ch_zero() ||
-		    (linenum = find_linenum(len)) <= 0)
+		if (len == NULL_POSITION || len == ch_zero())
+			ap_quest();
+		else if ((linenum = index_linenums_partial()) > 0)
+		{
+			/* Still counting lines; show what we know so far. */
+			if (currline(BOTTOM) > linenum)
+				linenum = currline(BOTTOM);
+			ap_linenum(vlinenum(linenum));
+			ap_char('+');
+		} else if ((linenum = find_linenum(len)) <= 0)
 			ap_quest();
 		else
 			ap_linenum(vlinenum(linenum-1));
@@ -349,6 +393,30 @@ static void protochar(char c, int where)
 #endif
 			ap_int(nifile());
 		break; }
+	case 'M': /* Number of the current match, of all matching lines */
+#if HILITE_SEARCH
+		{
+			lbool done;
+			LINENUM nmatch = match_count(&done);
+			if (nmatch < 0)
+				ap_quest();
+			else
+			{
+				linenum = match_number(position(where));
+				if (linenum < 0)
+					ap_quest();
+				else
+					ap_linenum(linenum);
+				ap_char('/');
+				ap_linenum(nmatch);
+				if (!done)
+					ap_char('+');
+			}
+		}
+#else
+		ap_quest();
+#endif
+		break;
 	case 'o': /* path (URI without protocol) of selected OSC8 link */
 #if OSC8_LINK
 		if (osc8_path != NULL)
@@ -369,6 +437,7 @@ static void protochar(char c, int where)
 		linenum = currline(where);
 		if (linenum == 0 ||
 		    (len = ch_length()) == NULL_POSITION || len == ch_zero() ||
+		    index_linenums_partial() > 0 ||
 		    (last_linenum = find_linenum(len)) <= 0)
 			ap_quest();
 		else
@@ -473,7 +542,7 @@ static constant char * wherechar(char constant *p, int *wp)
 {
 	switch (*p)
 	{
-	case 'b': case 'd': case 'l': case 'p': case 'P':
+	case 'b': case 'd': case 'l': case 'M': case 'p': case 'P':
 		switch (*++p)
 		{
 		case 't':   *wp = TOP;                  break;
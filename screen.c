@@ -290,6 +290,8 @@ extern int shell_lines;
 static constant char *cheaper(constant char *t1, constant char *t2, constant char *def);
 static void tmodes(constant char *inti, constant char *outti, constant char *intc, constant char *outtc, constant char **instr,
     constant char **outstr, constant char *def_instr, constant char *def_outstr, char **spp);
+static void tput_attr_in(int attr, int (*f_putc)(int));
+static void tput_attr_out(int attr, int (*f_putc)(int));
 #endif
 
 extern int quiet;               /* If VERY_QUIET, use visual bell for bell */
@@ -305,6 +307,7 @@ extern int mousecap;
 extern int is_tty;
 extern int use_color;
 extern int no_paste;
+extern int ctldisp;
 #if HILITE_SEARCH
 extern int hilite_search;
 #endif
@@ -1845,7 +1848,11 @@ static void do_tputs(constant char *str, int affcnt, int (*f_putc)(int))
 #if LESSTEST
 	if (is_lesstest() && f_putc == putchr)
 		putstr(str);
-	else
+	else if (is_lesstest() && f_putc == putctl)
+	{
+		while (*str != '\0')
+			putctl(*str++);
+	} else
 #endif /*LESSTEST*/
 		tputs(str, affcnt, f_putc);
 }
@@ -1892,8 +1899,531 @@ static void ltputs(constant char *str, int affcnt, int (*f_putc)(int))
 		break;
 	}
 }
+
+/*
+ * The shadow screen is a copy of what we have put on the screen,
+ * so that a full redraw can be reduced to the lines which actually
+ * changed.  Less writes the screen a line at a time, so rather than
+ * tracking each character cell we keep, for each screen line, the
+ * bytes which have been output to it since it was last cleared.
+ * Replaying those bytes at the left edge reproduces the line.
+ */
+struct shadow_row
+{
+	char *text;             /* Bytes output to the line since it was cleared */
+	size_t len;             /* Number of bytes in text */
+	size_t size;            /* Allocated size of text */
+	lbool known;            /* Do we know what's on the line? */
+	int start_attr;         /* Attributes in effect when the line was cleared */
+	int end_attr;           /* Attributes in effect after the text */
+	size_t wrap_len;        /* Length of text when the terminal wrapped, or 0 */
+};
+
+static struct shadow_row *shadow = NULL;      /* The screen now */
+static struct shadow_row *shadow_old = NULL;  /* The screen when the frame began */
+static int shadow_height = 0;
+static int shadow_width = 0;
+static lbool shadow_on = FALSE;
+static int shadow_cursor = -1;      /* Cursor line, or -1 if unknown */
+static lbool shadow_at_left;        /* Is the cursor at the left edge? */
+
+static int frame_depth = 0;
+static lbool frame_deferred = FALSE; /* Holding output until the frame ends */
+static int frame_cursor;            /* Cursor line when the frame began */
+static lbool frame_at_left;
+static int frame_attr;              /* Attributes in effect when the frame began */
+static int out_cursor;              /* Real cursor line while ending a frame */
+static lbool out_at_left;
+static int out_attr;                /* Real attributes while ending a frame */
+
+/*
+ * Can we keep track of what is on the screen?
+ * Raw control chars (-r) move the cursor in ways we don't follow.
+ */
+static lbool shadow_usable(void)
+{
+	return (interactive() && can_goto_line && *sc_eol_clear != '\0' &&
+		ctldisp != OPT_ON);
+}
+
+/*
+ * Forget everything we know about the screen.
+ */
+static void shadow_forget(void)
+{
+	int i;
+
+	for (i = 0;  i < shadow_height;  i++)
+		shadow[i].known = FALSE;
+	shadow_cursor = -1;
+}
+
+static void free_rows(struct shadow_row *rows, int n)
+{
+	int i;
+
+	if (rows == NULL)
+		return;
+	for (i = 0;  i < n;  i++)
+		free(rows[i].text);
+	free(rows);
+}
+
+/*
+ * Make sure the shadow screen matches the size of the screen.
+ * Return FALSE if we are not keeping a shadow screen.
+ */
+static lbool shadow_check(void)
+{
+	lbool usable = shadow_usable();
+
+	if (usable && shadow_on && shadow_height == sc_height && shadow_width == sc_width)
+		return (TRUE);
+	if (frame_deferred)
+	{
+		/* The held output no longer fits the screen. */
+		frame_deferred = FALSE;
+		screen_trashed();
+	}
+	shadow_on = usable;
+	if (!usable)
+		return (FALSE);
+	if (shadow_height != sc_height)
+	{
+		free_rows(shadow, shadow_height);
+		free_rows(shadow_old, shadow_height);
+		shadow = (struct shadow_row *) ecalloc((size_t) sc_height, sizeof(struct shadow_row));
+		shadow_old = (struct shadow_row *) ecalloc((size_t) sc_height, sizeof(struct shadow_row));
+		shadow_height = sc_height;
+	}
+	shadow_width = sc_width;
+	shadow_forget();
+	return (TRUE);
+}
+
+static void row_clear(struct shadow_row *row)
+{
+	row->len = 0;
+	row->known = TRUE;
+	row->wrap_len = 0;
+	row->start_attr = row->end_attr = attrmode;
+}
+
+/*
+ * Make sure a row can hold n bytes.
+ */
+static void row_expand(struct shadow_row *row, size_t n)
+{
+	char *text;
+	size_t size;
+
+	if (n <= row->size)
+		return;
+	size = (row->size == 0) ? 128 : row->size;
+	while (size < n)
+		size *= 2;
+	text = (char *) ecalloc(size, sizeof(char));
+	if (row->len > 0)
+		memcpy(text, row->text, row->len);
+	free(row->text);
+	row->text = text;
+	row->size = size;
+}
+
+static void row_add(struct shadow_row *row, char c)
+{
+	if (!row->known)
+		return;
+	if (row->len >= row->size)
+	{
+		/*
+		 * A line which is rewritten over and over without being
+		 * cleared (such as the command line) would grow without
+		 * limit.  Give up on it; the next clear makes it known again.
+		 * Inside a frame we must keep everything, but a frame
+		 * only writes each line a bounded number of times.
+		 */
+		if (!frame_deferred && row->len >= (size_t) shadow_width * 16 + 256)
+		{
+			row->known = FALSE;
+			return;
+		}
+		row_expand(row, row->len + 1);
+	}
+	row->text[row->len++] = c;
+	row->end_attr = attrmode;
+}
+
+/*
+ * The cursor moves to the start of the next line,
+ * scrolling the screen if it's on the bottom line.
+ */
+static void shadow_newline(void)
+{
+	struct shadow_row top;
+
+	shadow_at_left = TRUE;
+	if (shadow_cursor < shadow_height - 1)
+	{
+		shadow_cursor++;
+		return;
+	}
+	top = shadow[0];
+	memmove(&shadow[0], &shadow[1], (size_t) (shadow_height - 1) * sizeof(struct shadow_row));
+	shadow[shadow_height - 1] = top;
+	row_clear(&shadow[shadow_height - 1]);
+}
+
+/*
+ * Cursor motion and clearing go through these, which update the
+ * shadow screen before the control sequence is output.
+ * A pending bottom-line clear must happen first, since it moves the cursor.
+ */
+static void shadow_goto(int sindex)
+{
+	clear_bot_if_needed();
+	if (!shadow_check())
+		return;
+	shadow_cursor = sindex;
+	shadow_at_left = TRUE;
+}
+
+static void shadow_return(void)
+{
+	clear_bot_if_needed();
+	if (!shadow_check())
+		return;
+	shadow_at_left = TRUE;
+}
+
+static void shadow_clear(void)
+{
+	int i;
+
+	clear_bot_if_needed();
+	if (!shadow_check())
+		return;
+	for (i = 0;  i < shadow_height;  i++)
+		row_clear(&shadow[i]);
+	shadow_cursor = 0;
+	shadow_at_left = TRUE;
+}
+
+/*
+ * A blank line is inserted at the cursor, pushing the lines below down.
+ */
+static void shadow_insert(void)
+{
+	struct shadow_row bottom;
+
+	clear_bot_if_needed();
+	if (!shadow_check())
+		return;
+	if (shadow_cursor < 0)
+	{
+		shadow_forget();
+		return;
+	}
+	bottom = shadow[shadow_height - 1];
+	memmove(&shadow[shadow_cursor + 1], &shadow[shadow_cursor],
+		(size_t) (shadow_height - 1 - shadow_cursor) * sizeof(struct shadow_row));
+	shadow[shadow_cursor] = bottom;
+	row_clear(&shadow[shadow_cursor]);
+	shadow_at_left = TRUE;
+}
+
+/*
+ * The rest of the cursor's line (and all lines below it if to_bot)
+ * is being cleared.  Return TRUE if that empties the line,
+ * so the clear is not part of the text on the line.
+ */
+static lbool shadow_clear_eol(lbool to_bot)
+{
+	int i;
+
+	clear_bot_if_needed();
+	if (!shadow_check())
+		return (TRUE);
+	if (shadow_cursor < 0)
+	{
+		shadow_forget();
+		return (TRUE);
+	}
+	if (to_bot)
+		for (i = shadow_cursor + 1;  i < shadow_height;  i++)
+			row_clear(&shadow[i]);
+	if (!shadow_at_left)
+		return (FALSE);
+	row_clear(&shadow[shadow_cursor]);
+	return (TRUE);
+}
+
+/*
+ * Output a control sequence which the shadow screen has accounted for.
+ * While a frame is held, the frame's own cursor motion replaces it.
+ */
+static void ltputs_ctl(constant char *str, int affcnt)
+{
+	if (!frame_deferred)
+		ltputs(str, affcnt, putctl);
+}
+
+/*
+ * Output a clear to end of line (or screen, if to_bot).
+ * If the cursor is not at the left edge, the clear becomes
+ * part of the text on the cursor's line.
+ */
+static void ltputs_clear(constant char *str, lbool to_bot)
+{
+	if (shadow_clear_eol(to_bot))
+		ltputs_ctl(str, 1);
+	else
+		ltputs(str, 1, putchr);
+}
+
+/*
+ * Move the real cursor to the left edge of a line while ending a frame.
+ * A few newlines are cheaper than a cursor address.
+ */
+static void out_goto(int sindex)
+{
+	constant char *move;
+
+	if (sindex == out_cursor)
+	{
+		if (!out_at_left)
+			ltputs(sc_return, 1, putctl);
+	} else
+	{
+		move = ltgoto(sc_move, 0, sindex);
+		if (sindex > out_cursor && (size_t) (sindex - out_cursor) * 2 <= strlen(move))
+		{
+			for (;  out_cursor < sindex;  out_cursor++)
+				putctl('\n');
+		} else
+			ltputs(move, 1, putctl);
+	}
+	out_cursor = sindex;
+	out_at_left = TRUE;
+}
+
+/*
+ * Change the real attributes while ending a frame.
+ */
+static void out_switch(int attr)
+{
+	if (attr == out_attr)
+		return;
+	tput_attr_out(out_attr, putctl);
+	tput_attr_in(attr, putctl);
+	out_attr = attr;
+}
+
+/*
+ * Redraw one line while ending a frame.
+ * The lines are not output in the order they were written,
+ * so each starts in the attributes it was written with.
+ */
+static void out_row(int sindex, lbool clear)
+{
+	struct shadow_row *row = &shadow[sindex];
+	size_t i;
+
+	out_goto(sindex);
+	out_switch(row->start_attr);
+	if (clear)
+		ltputs(sc_eol_clear, 1, putctl);
+	for (i = 0;  i < row->len;  i++)
+	{
+		if (i > 0 && i == row->wrap_len)
+		{
+			/*
+			 * The terminal has wrapped to the next line,
+			 * and the rest of the text was written after
+			 * coming back to the start of this one.
+			 */
+			ltputs(ltgoto(sc_move, 0, sindex), 1, putctl);
+			if (row->text[i] == '\r')
+				continue;
+		}
+		putctl(row->text[i]);
+	}
+	out_attr = row->end_attr;
+	if (row->wrap_len > 0 && row->wrap_len == row->len)
+	{
+		/* Never the bottom line, since wrapping there scrolls. */
+		out_cursor = sindex + 1;
+		out_at_left = TRUE;
+	} else
+		out_at_left = (row->len == 0);
+}
+
+static lbool row_changed(int sindex)
+{
+	struct shadow_row *row = &shadow[sindex];
+	struct shadow_row *old = &shadow_old[sindex];
+
+	return (row->len != old->len || row->start_attr != old->start_attr ||
+		(row->len > 0 && memcmp(row->text, old->text, row->len) != 0));
+}
+
+/*
+ * The attributes changed; the cursor's line ends in the new ones.
+ */
+static void shadow_attr(void)
+{
+	if (shadow_on && shadow_cursor >= 0 && shadow_cursor < shadow_height)
+		shadow[shadow_cursor].end_attr = attrmode;
+}
 #endif /* MSDOS_COMPILER */
 
+/*
+ * Text is being output to the screen.
+ * Return TRUE if it is being held for the current frame.
+ */
+public lbool shadow_putchr(char c)
+{
+#if MSDOS_COMPILER
+	return (FALSE);
+#else
+	struct shadow_row *row;
+
+	if (!shadow_check() || c == CONTROL('G'))
+		return (FALSE);
+	if (shadow_cursor < 0)
+	{
+		shadow_forget();
+		return (FALSE);
+	}
+	if (c == '\n')
+	{
+		shadow_newline();
+		return (frame_deferred);
+	}
+	row = &shadow[shadow_cursor];
+	if (shadow_at_left && row->len > 0)
+		row_add(row, '\r');
+	row_add(row, c);
+	shadow_at_left = FALSE;
+	return (frame_deferred);
+#endif
+}
+
+/*
+ * A line filled the width of the screen and the terminal
+ * wrapped to the next line (or, with defer_wrap, the next char will
+ * make it wrap).
+ */
+public void shadow_wrap(void)
+{
+#if !MSDOS_COMPILER
+	if (!shadow_check() || shadow_cursor < 0)
+		return;
+	if (!defer_wrap)
+	{
+		struct shadow_row *row = &shadow[shadow_cursor];
+		/* We only remember one wrap on each line. */
+		if (row->wrap_len > 0 || row->len == 0)
+			row->known = FALSE;
+		else
+			row->wrap_len = row->len;
+	}
+	shadow_newline();
+#endif
+}
+
+/*
+ * The screen may not show what we think it does,
+ * so the next redraw must output every line.
+ */
+public void forget_screen(void)
+{
+#if !MSDOS_COMPILER
+	flush_frame();
+	shadow_forget();
+#endif
+}
+
+/*
+ * Begin a frame: a redraw of the screen whose output is held
+ * until end_frame, then only the lines which changed are output.
+ * Frames nest; only the outermost one holds output.
+ */
+public void begin_frame(void)
+{
+#if !MSDOS_COMPILER
+	int i;
+
+	if (frame_depth++ > 0)
+		return;
+	clear_bot_if_needed();
+	/*
+	 * Don't hold output while we may wait for input from a pipe;
+	 * the user should see the lines as they arrive.
+	 */
+	if (!shadow_check() || shadow_cursor < 0 || !(ch_getflags() & CH_CANSEEK))
+		return;
+	for (i = 0;  i < shadow_height;  i++)
+		if (!shadow[i].known)
+			return;
+	for (i = 0;  i < shadow_height;  i++)
+	{
+		row_expand(&shadow_old[i], shadow[i].len);
+		if (shadow[i].len > 0)
+			memcpy(shadow_old[i].text, shadow[i].text, shadow[i].len);
+		shadow_old[i].len = shadow[i].len;
+		shadow_old[i].known = TRUE;
+		shadow_old[i].start_attr = shadow[i].start_attr;
+		shadow_old[i].end_attr = shadow[i].end_attr;
+	}
+	frame_cursor = shadow_cursor;
+	frame_attr = attrmode;
+	frame_at_left = shadow_at_left;
+	frame_deferred = TRUE;
+#endif
+}
+
+/*
+ * End a frame.
+ */
+public void end_frame(void)
+{
+	if (frame_depth > 0 && --frame_depth == 0)
+		flush_frame();
+}
+
+/*
+ * Output the lines which changed during the current frame.
+ * Output after this is not held, even if the frame has not ended.
+ * Called before anything which must be seen right away,
+ * such as a message or waiting for a keystroke.
+ */
+public void flush_frame(void)
+{
+#if !MSDOS_COMPILER
+	int i;
+
+	if (!frame_deferred)
+		return;
+	frame_deferred = FALSE;
+	out_cursor = frame_cursor;
+	out_at_left = frame_at_left;
+	out_attr = frame_attr;
+	/* The cursor's line is done last, to leave the cursor where it belongs. */
+	for (i = 0;  i < shadow_height;  i++)
+		if (i != shadow_cursor && row_changed(i))
+			out_row(i, shadow_old[i].len > 0);
+	i = shadow_cursor;
+	if (row_changed(i))
+		out_row(i, shadow_old[i].len > 0);
+	else if (!shadow_at_left)
+		out_row(i, FALSE);
+	else
+		out_goto(i);
+	out_switch(attrmode);
+#endif
+}
+
 /*
  * Configure the terminal so mouse clicks and wheel moves 
  * produce input to less.
@@ -1901,7 +2431,7 @@ static void ltputs(constant char *str, int affcnt, int (*f_putc)(int))
 public void init_mouse(void)
 {
 #if !MSDOS_COMPILER
-	ltputs(sc_s_mousecap, sc_height, putchr);
+	ltputs(sc_s_mousecap, sc_height, putctl);
 #else
 #if MSDOS_COMPILER==WIN32C
 	curr_console_input_mode = mouse_console_input_mode;
@@ -1917,7 +2447,7 @@ public void init_mouse(void)
 public void deinit_mouse(void)
 {
 #if !MSDOS_COMPILER
-	ltputs(sc_e_mousecap, sc_height, putchr);
+	ltputs(sc_e_mousecap, sc_height, putctl);
 #else
 #if MSDOS_COMPILER==WIN32C
 	curr_console_input_mode = base_console_input_mode;
@@ -1932,7 +2462,7 @@ public void deinit_mouse(void)
 public void suspend_screen(void)
 {
 #if !MSDOS_COMPILER
-	ltputs(sc_suspend, 1, putchr);
+	ltputs(sc_suspend, 1, putctl);
 #endif
 }
 
@@ -1942,7 +2472,7 @@ public void suspend_screen(void)
 public void resume_screen(void)
 {
 #if !MSDOS_COMPILER
-	ltputs(sc_resume, 1, putchr);
+	ltputs(sc_resume, 1, putctl);
 #endif
 }
 
@@ -1956,11 +2486,12 @@ public void term_init(void)
 	term_init_done = TRUE;
 	clear_bot_if_needed();
 #if !MSDOS_COMPILER
+	shadow_forget();
 	if (!(quit_if_one_screen && one_screen))
 	{
 		if (!no_init)
 		{
-			ltputs(sc_init, sc_height, putchr);
+			ltputs(sc_init, sc_height, putctl);
 			/*
 			 * Some terminals leave the cursor unmoved when switching 
 			 * to the alt screen. To avoid having the text appear at
@@ -1972,7 +2503,7 @@ public void term_init(void)
 			term_addrs = TRUE;
 		}
 		if (!no_keypad)
-			ltputs(sc_s_keypad, sc_height, putchr);
+			ltputs(sc_s_keypad, sc_height, putctl);
 		if (mousecap)
 			init_mouse();
 		if (no_paste)
@@ -2020,6 +2551,8 @@ public void term_deinit(void)
 	if (!term_init_done)
 		return;
 #if !MSDOS_COMPILER
+	flush_frame();
+	shadow_forget();
 	if (!(quit_if_one_screen && one_screen))
 	{
 		if (mousecap)
@@ -2027,9 +2560,9 @@ public void term_deinit(void)
         if (no_paste)
             deinit_bracketed_paste();
 		if (!no_keypad)
-			ltputs(sc_e_keypad, sc_height, putchr);
+			ltputs(sc_e_keypad, sc_height, putctl);
 		if (!no_init)
-			ltputs(sc_deinit, sc_height, putchr);
+			ltputs(sc_deinit, sc_height, putctl);
 	}
 #else
 	/* Restore system colors. */
@@ -2072,7 +2605,8 @@ public void home(void)
 {
 	assert_interactive();
 #if !MSDOS_COMPILER
-	ltputs(sc_home, 1, putchr);
+	shadow_goto(0);
+	ltputs_ctl(sc_home, 1);
 #else
 	flush();
 	_settextposition(1,1);
@@ -2084,7 +2618,7 @@ public void dump_screen(void)
 {
 	char dump_cmd[32];
 	SNPRINTF1(dump_cmd, sizeof(dump_cmd), ESCS"0;0;%dR", sc_width * sc_height);
-	ltputs(dump_cmd, sc_height, putchr);
+	ltputs(dump_cmd, sc_height, putctl);
 	flush();
 }
 #endif /*LESSTEST*/
@@ -2097,7 +2631,8 @@ public void add_line(void)
 {
 	assert_interactive();
 #if !MSDOS_COMPILER
-	ltputs(sc_addline, sc_height, putchr);
+	shadow_insert();
+	ltputs_ctl(sc_addline, sc_height);
 #else
 	flush();
 #if MSDOS_COMPILER==MSOFTC
@@ -2301,7 +2836,8 @@ public void lower_left(void)
 {
 	assert_interactive();
 #if !MSDOS_COMPILER
-	ltputs(sc_lower_left, 1, putchr);
+	shadow_goto(sc_height-1);
+	ltputs_ctl(sc_lower_left, 1);
 #else
 	flush();
 	_settextposition(sc_height, 1);
@@ -2315,7 +2851,8 @@ public void line_left(void)
 {
 	assert_interactive();
 #if !MSDOS_COMPILER
-	ltputs(sc_return, 1, putchr);
+	shadow_return();
+	ltputs_ctl(sc_return, 1);
 #else
 	{
 		int row;
@@ -2378,7 +2915,8 @@ public void goto_line(int sindex)
 {
 	assert_interactive();
 #if !MSDOS_COMPILER
-	ltputs(ltgoto(sc_move, 0, sindex), 1, putchr);
+	shadow_goto(sindex);
+	ltputs_ctl(ltgoto(sc_move, 0, sindex), 1);
 #else
 	flush();
 	_settextposition(sindex+1, 1);
@@ -2445,7 +2983,7 @@ public void vbell(void)
 #if !MSDOS_COMPILER
 	if (*sc_visual_bell == '\0')
 		return;
-	ltputs(sc_visual_bell, sc_height, putchr);
+	ltputs(sc_visual_bell, sc_height, putctl);
 #else
 #if MSDOS_COMPILER==DJGPPC
 	ScreenVisualBell();
@@ -2535,7 +3073,8 @@ public void lclear(void)
 	assert_interactive();
 	suspend_screen();
 #if !MSDOS_COMPILER
-	ltputs(sc_clear, sc_height, putchr);
+	shadow_clear();
+	ltputs_ctl(sc_clear, sc_height);
 #else
 	flush();
 #if MSDOS_COMPILER==WIN32C
@@ -2554,7 +3093,7 @@ public void clear_eol(void)
 {
 	/* assert_interactive();*/
 #if !MSDOS_COMPILER
-	ltputs(sc_eol_clear, 1, putchr);
+	ltputs_clear(sc_eol_clear, FALSE);
 #else
 #if MSDOS_COMPILER==MSOFTC
 	short top, left;
@@ -2616,9 +3155,9 @@ static void clear_eol_bot(void)
 	clear_eol();
 #else
 	if (below_mem)
-		ltputs(sc_eos_clear, 1, putchr);
+		ltputs_clear(sc_eos_clear, TRUE);
 	else
-		ltputs(sc_eol_clear, 1, putchr);
+		ltputs_clear(sc_eol_clear, FALSE);
 #endif
 }
 
@@ -2658,14 +3197,14 @@ public void clear_bot(void)
 public void init_bracketed_paste(void)
 {
 #if !MSDOS_COMPILER
-    ltputs(sc_s_bracketed_paste, 1, putchr);
+    ltputs(sc_s_bracketed_paste, 1, putctl);
 #endif
 }
 
 public void deinit_bracketed_paste(void)
 {
 #if !MSDOS_COMPILER
-    ltputs(sc_e_bracketed_paste, 1, putchr);
+    ltputs(sc_e_bracketed_paste, 1, putctl);
 #endif
 }
 
@@ -2893,13 +3432,36 @@ static void tput_inmode(constant char *mode_str, int attr, int attr_bit, int (*f
 	tput_color(color_str, f_putc);
 }
 
-static void tput_outmode(constant char *mode_str, int attr_bit, int (*f_putc)(int))
+static void tput_outmode(constant char *mode_str, int attr, int attr_bit, int (*f_putc)(int))
 {
-	if ((attrmode & attr_bit) == 0)
+	if ((attr & attr_bit) == 0)
 		return;
 	ltputs(mode_str, 1, f_putc);
 }
 
+static void tput_attr_in(int attr, int (*f_putc)(int))
+{
+	/* The one with the most priority is last.  */
+	tput_inmode(sc_u_in, attr, AT_UNDERLINE, f_putc);
+	tput_inmode(sc_b_in, attr, AT_BOLD, f_putc);
+	tput_inmode(sc_bl_in, attr, AT_BLINK, f_putc);
+	/* Don't use standout and color at the same time. */
+	if (use_color && (attr & AT_COLOR))
+		tput_color(get_color_map(attr), f_putc);
+	else
+		tput_inmode(sc_s_in, attr, AT_STANDOUT, f_putc);
+}
+
+static void tput_attr_out(int attr, int (*f_putc)(int))
+{
+	/* Undo things in the reverse order we did them.  */
+	tput_color("*", f_putc);
+	tput_outmode(sc_s_out, attr, AT_STANDOUT, f_putc);
+	tput_outmode(sc_bl_out, attr, AT_BLINK, f_putc);
+	tput_outmode(sc_b_out, attr, AT_BOLD, f_putc);
+	tput_outmode(sc_u_out, attr, AT_UNDERLINE, f_putc);
+}
+
 #else /* MSDOS_COMPILER */
 
 #if MSDOS_COMPILER==WIN32C
@@ -2979,15 +3541,7 @@ public void at_enter(int attr)
 {
 	attr = apply_at_specials(attr);
 #if !MSDOS_COMPILER
-	/* The one with the most priority is last.  */
-	tput_inmode(sc_u_in, attr, AT_UNDERLINE, putchr);
-	tput_inmode(sc_b_in, attr, AT_BOLD, putchr);
-	tput_inmode(sc_bl_in, attr, AT_BLINK, putchr);
-	/* Don't use standout and color at the same time. */
-	if (use_color && (attr & AT_COLOR))
-		tput_color(get_color_map(attr), putchr);
-	else
-		tput_inmode(sc_s_in, attr, AT_STANDOUT, putchr);
+	tput_attr_in(attr, putchr);
 #else
 	flush();
 	/* The one with the most priority is first.  */
@@ -3009,22 +3563,23 @@ public void at_enter(int attr)
 	}
 #endif
 	attrmode = attr;
+#if !MSDOS_COMPILER
+	shadow_attr();
+#endif
 }
 
 public void at_exit(void)
 {
 #if !MSDOS_COMPILER
-	/* Undo things in the reverse order we did them.  */
-	tput_color("*", putchr);
-	tput_outmode(sc_s_out, AT_STANDOUT, putchr);
-	tput_outmode(sc_bl_out, AT_BLINK, putchr);
-	tput_outmode(sc_b_out, AT_BOLD, putchr);
-	tput_outmode(sc_u_out, AT_UNDERLINE, putchr);
+	tput_attr_out(attrmode, putchr);
 #else
 	flush();
 	SETCOLORS(nm_fg_color, nm_bg_color);
 #endif
 	attrmode = AT_NORMAL;
+#if !MSDOS_COMPILER
+	shadow_attr();
+#endif
 }
 
 public void at_switch(int attr)
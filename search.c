@@ -19,6 +19,31 @@
 #define MINPOS(a,b)     (((a) < (b)) ? (a) : (b))
 #define MAXPOS(a,b)     (((a) > (b)) ? (a) : (b))
 
+/*
+ * Parallel search needs threads, pread, and a pattern matcher
+ * which can be called from several threads at once.
+ */
+#if HAVE_PTHREAD_H && HAVE_PTHREAD_CREATE && HAVE_PREAD && (HAVE_POSIX_REGCOMP || HAVE_PCRE || HAVE_PCRE2 || NO_REGEX)
+#define PAR_SEARCH 1
+#include <pthread.h>
+#include <signal.h>
+#include <errno.h>
+#else
+#define PAR_SEARCH 0
+#endif
+
+/* Most bytes to match at once in a block search. */
+#define BLOCK_SEARCH_SIZE (1024*1024)
+
+/* Most filters to match with one DFA. */
+#define FILTER_DFA_MAX 32
+
+/* Bytes checked per count_filter_lines call. */
+#define FILTER_COUNT_CHUNK (1024*1024)
+
+/* Bytes checked per index_matches call. */
+#define MATCH_INDEX_CHUNK (1024*1024)
+
 extern int sigs;
 extern int how_search;
 extern int caseless;
@@ -42,6 +67,9 @@ extern int nosearch_header_cols;
 extern int header_lines;
 extern int header_cols;
 extern LWCHAR rscroll_char;
+extern int search_threads;
+extern int filter_count;
+extern int index_matches;
 #if HILITE_SEARCH
 extern int hilite_search;
 extern lbool squished;
@@ -68,6 +96,8 @@ char *osc8_uri = NULL;
 constant char *osc8_search_param = NULL;
 #endif
 
+static lbool indexed_search(POSITION pos, int search_type, int *pn, POSITION *plinepos, POSITION *plastlinepos);
+
 /*
  * Structures for maintaining a set of ranges for hilites and filtered-out
  * lines. Each range is stored as a node within a red-black tree, and we
@@ -118,8 +148,57 @@ struct hilite_tree
 #define HILITE_LOOKASIDE_STEPS 2
 
 static struct hilite_tree hilite_anchor = HILITE_INITIALIZER();
-static struct hilite_tree filter_anchor = HILITE_INITIALIZER();
+
+/*
+ * A set of file positions, kept as a sorted array of ranges.
+ * Touching ranges are joined, so a long run of lines takes one entry.
+ */
+struct pos_range
+{
+	POSITION start;
+	POSITION end;
+};
+struct range_set
+{
+	struct pos_range *ranges;
+	size_t count;
+	size_t size;
+	size_t last;            /* Index of the range found last */
+};
+#define RANGE_SET_INITIALIZER() { NULL, 0, 0, 0 }
+
+static struct range_set filter_hidden = RANGE_SET_INITIALIZER(); /* Lines hidden by the filters */
+static struct range_set filter_known = RANGE_SET_INITIALIZER(); /* Lines already matched against the filters */
+static POSITION filter_tail = NULL_POSITION; /* Last line matched against the filters, if at end of file */
+static POSITION filter_tail_end = NULL_POSITION;
 static struct pattern_info *filter_infos = NULL;
+static struct dfa *filter_dfa = NULL;   /* All filters matched at once, or NULL */
+static unsigned int filter_invert = 0;  /* Filters in filter_dfa which hide non-matching lines */
+
+/*
+ * The positions of the lines shown by the filters, in order.
+ * The file has been checked from the start up to filter_count_pos.
+ */
+static POSITION *filter_lines = NULL;
+static size_t filter_lines_count = 0;
+static size_t filter_lines_size = 0;
+static POSITION filter_count_pos = 0;
+static lbool filter_count_done = FALSE;
+
+/*
+ * The positions of the lines which match the search pattern, in order.
+ * The file has been checked from the start up to match_index_pos.
+ * When the whole file has been checked, match_index_end is its length.
+ * A last line without a newline is in match_lines, but match_index_pos
+ * stays at its start, so it is checked again if the file grows.
+ */
+static POSITION *match_lines = NULL;
+static size_t match_lines_count = 0;
+static size_t match_lines_size = 0;
+static POSITION match_index_pos = 0;
+static POSITION match_index_end = NULL_POSITION;
+static lbool match_index_done = FALSE;
+static int match_index_cvt_ops = -1; /* cvt_ops used to build the index */
 
 #endif
 
@@ -129,9 +208,16 @@ static struct pattern_info *filter_infos = NULL;
  */
 struct pattern_info {
 	PATTERN_TYPE compiled;
+	PATTERN_TYPE block_compiled;  /* For match_block, or null if unusable */
+	MATCH_DATA_TYPE match_data;   /* Match results for compiled */
+	MATCH_DATA_TYPE block_match_data; /* Match results for block_compiled */
+	struct dfa *dfa;        /* Used instead of compiled, if not NULL */
 	char* text;
+	char* literal;          /* String which every match contains, or NULL */
+	size_t literal_len;
 	int search_type;
 	lbool is_ucase_pattern;
+	lbool is_caseless;      /* Pattern was compiled to ignore case */
 	struct pattern_info *next;
 };
 
@@ -169,9 +255,14 @@ static void clear_pattern(struct pattern_info *info)
 	if (info->text != NULL)
 		free(info->text);
 	info->text = NULL;
+	if (info->literal != NULL)
+		free(info->literal);
+	info->literal = NULL;
 #if !NO_REGEX
-	uncompile_pattern(&info->compiled);
+	uncompile_pattern(&info->compiled, &info->match_data);
+	uncompile_pattern(&info->block_compiled, &info->block_match_data);
 #endif
+	uncompile_dfa_pattern(&info->dfa);
 }
 
 /*
@@ -185,12 +276,30 @@ static int set_pattern(struct pattern_info *info, constant char *pattern, int se
 	 */
 	info->is_ucase_pattern = (pattern == NULL) ? FALSE : is_ucase(pattern);
 	is_caseless = (info->is_ucase_pattern && caseless != OPT_ONPLUS) ? 0 : caseless;
+	info->is_caseless = (is_caseless != 0);
+	if (pattern != NULL && (search_type & (SRCH_DFA|SRCH_NO_REGEX)) == SRCH_DFA)
+	{
+		if (compile_dfa_pattern(pattern, show_error, &info->dfa) < 0)
+			return -1;
 #if !NO_REGEX
-	if (pattern == NULL)
-		SET_NULL_PATTERN(info->compiled);
-	else if (compile_pattern(pattern, search_type, show_error, &info->compiled) < 0)
-		return -1;
+		uncompile_pattern(&info->compiled, &info->match_data);
+		uncompile_pattern(&info->block_compiled, &info->block_match_data);
+#endif
+	} else
+	{
+#if !NO_REGEX
+		if (pattern == NULL)
+			SET_NULL_PATTERN(info->compiled);
+		else if (compile_pattern(pattern, search_type, show_error, &info->compiled, &info->match_data) < 0)
+			return -1;
+		/*
+		 * Also compile it for matching many lines at once, if possible.
+		 */
+		if (pattern == NULL || compile_block_pattern(pattern, search_type, &info->block_compiled, &info->block_match_data) < 0)
+			uncompile_pattern(&info->block_compiled, &info->block_match_data);
 #endif
+		uncompile_dfa_pattern(&info->dfa);
+	}
 	/* Pattern compiled successfully; save the text too. */
 	if (info->text != NULL)
 		free(info->text);
@@ -200,17 +309,69 @@ static int set_pattern(struct pattern_info *info, constant char *pattern, int se
 		info->text = (char *) ecalloc(1, strlen(pattern)+1);
 		strcpy(info->text, pattern);
 	}
+	/*
+	 * Find a string which every match must contain.
+	 * Don't bother if the match may ignore case.
+	 */
+	if (info->literal != NULL)
+		free(info->literal);
+	info->literal = NULL;
+	info->literal_len = 0;
+	if (pattern != NULL && !is_caseless && !(search_type & SRCH_NO_REGEX))
+	{
+		info->literal = pattern_literal(pattern);
+		if (info->literal != NULL)
+			info->literal_len = strlen(info->literal);
+	}
 	info->search_type = search_type;
 	return 0;
 }
 
+/*
+ * Does a line match a saved pattern?
+ * If the pattern has a literal string which every match contains,
+ * first check for that, and skip the pattern matcher if it's absent.
+ */
+static lbool match_info(struct pattern_info *info, constant char *line, size_t line_len, constant char **sp, constant char **ep, int nsp, int search_type)
+{
+	if (info->literal != NULL)
+	{
+		constant char *p = line;
+		constant char *end = line + line_len;
+		lbool found = FALSE;
+		while ((size_t) (end - p) >= info->literal_len &&
+		       (p = (constant char *) memchr(p, info->literal[0], (size_t) (end - p) - info->literal_len + 1)) != NULL)
+		{
+			if (memcmp(p, info->literal, info->literal_len) == 0)
+			{
+				found = TRUE;
+				break;
+			}
+			p++;
+		}
+		if (!found)
+		{
+			*sp = *ep = NULL;
+			return ((search_type & SRCH_NO_MATCH) != 0);
+		}
+	}
+	return (match_pattern(info_compiled(info), info->match_data, info->dfa, info->text,
+		line, line_len, 0, sp, ep, nsp, 0, search_type));
+}
+
 /*
  * Initialize saved pattern to nothing.
  */
 static void init_pattern(struct pattern_info *info)
 {
 	SET_NULL_PATTERN(info->compiled);
+	SET_NULL_PATTERN(info->block_compiled);
+	info->match_data = NULL;
+	info->block_match_data = NULL;
+	info->dfa = NULL;
 	info->text = NULL;
+	info->literal = NULL;
+	info->literal_len = 0;
 	info->search_type = 0;
 	info->next = NULL;
 }
@@ -246,6 +407,8 @@ public int get_cvt_ops(int search_type)
  */
 static lbool prev_pattern(struct pattern_info *info)
 {
+	if (info->dfa != NULL)
+		return (TRUE);
 #if !NO_REGEX
 	if ((info->search_type & SRCH_NO_REGEX) == 0)
 		return (!is_null_pattern(info->compiled));
@@ -254,6 +417,18 @@ static lbool prev_pattern(struct pattern_info *info)
 }
 
 #if HILITE_SEARCH
+/*
+ * Hide or show the hilites.
+ * Lines formatted with the old setting can't be reused.
+ */
+static void set_hide_hilite(lbool hide)
+{
+	if (hide == hide_hilite)
+		return;
+	hide_hilite = hide;
+	clr_line_cache();
+}
+
 /*
  * Repaint the hilites currently displayed on the screen.
  * Repaint each line which contains highlighted text.
@@ -273,16 +448,17 @@ public void repaint_hilite(lbool on)
 	{
 		if (hide_hilite)
 			return;
-		hide_hilite = TRUE;
+		set_hide_hilite(TRUE);
 	}
 
 	if (!can_goto_line)
 	{
 		repaint();
-		hide_hilite = save_hide_hilite;
+		set_hide_hilite(save_hide_hilite);
 		return;
 	}
 
+	begin_frame();
 	for (sindex = TOP;  sindex < TOP + sc_height-1;  sindex++)
 	{
 		pos = position(sindex);
@@ -295,7 +471,8 @@ public void repaint_hilite(lbool on)
 	}
 	overlay_header();
 	lower_left();
-	hide_hilite = save_hide_hilite;
+	end_frame();
+	set_hide_hilite(save_hide_hilite);
 }
 #endif
 
@@ -317,6 +494,7 @@ public void clear_attn(void)
 	old_start_attnpos = start_attnpos;
 	old_end_attnpos = end_attnpos;
 	start_attnpos = end_attnpos = NULL_POSITION;
+	clr_line_cache();
 
 	if (!can_goto_line)
 	{
@@ -361,10 +539,11 @@ public void undo_search(lbool clear)
 	{
 		clear_pattern(&search_info);
 		clr_hilite();
+		clr_match_index();
 	} else
 	{
 		if (has_pattern)
-			hide_hilite = !hide_hilite;
+			set_hide_hilite(!hide_hilite);
 		else if (!osc8_active)
 			error("No previous regular expression", NULL_PARG);
 	}
@@ -383,27 +562,175 @@ public lbool undo_osc8(void)
 #if OSC8_LINK
 	was_active = (osc8_linepos != NULL_POSITION);
 	osc8_linepos = NULL_POSITION;
+	if (was_active)
+		clr_line_cache();
 #endif
 	return was_active;
 }
 
 #if HILITE_SEARCH
+/*
+ * Empty a range set, keeping its storage.
+ */
+static void clr_ranges(struct range_set *rs)
+{
+	rs->count = 0;
+	rs->last = 0;
+}
+
+/*
+ * Return the index of the range covering pos, or of the range after it
+ * if no range covers it, or rs->count if pos is after the last range.
+ * Positions are usually looked up in order, so try near the last one
+ * before searching the whole set.
+ */
+static size_t range_find(struct range_set *rs, POSITION pos)
+{
+	size_t lo, hi, mid;
+
+	for (lo = rs->last;  lo < rs->count && lo <= rs->last + 1;  lo++)
+	{
+		if (pos < rs->ranges[lo].end)
+		{
+			if (lo == 0 || pos >= rs->ranges[lo-1].end)
+				return (rs->last = lo);
+			break;
+		}
+	}
+	lo = 0;
+	hi = rs->count;
+	while (lo < hi)
+	{
+		mid = lo + (hi - lo) / 2;
+		if (pos < rs->ranges[mid].end)
+			hi = mid;
+		else
+			lo = mid + 1;
+	}
+	if (lo < rs->count)
+		rs->last = lo;
+	return (lo);
+}
+
+/*
+ * Is pos in a range set?
+ * If so, return the index of the range containing it in *p_index.
+ */
+static lbool in_ranges(struct range_set *rs, POSITION pos, size_t *p_index)
+{
+	size_t i = range_find(rs, pos);
+
+	if (i >= rs->count || pos < rs->ranges[i].start)
+		return (FALSE);
+	if (p_index != NULL)
+		*p_index = i;
+	return (TRUE);
+}
+
+/*
+ * Add the positions from start up to end to a range set,
+ * joining any ranges they overlap or touch.
+ */
+static void add_range(struct range_set *rs, POSITION start, POSITION end)
+{
+	size_t i, j;
+
+	if (start >= end)
+		return;
+	i = range_find(rs, start);
+	if (i > 0 && rs->ranges[i-1].end == start)
+		i--;
+	for (j = i;  j < rs->count && rs->ranges[j].start <= end;  j++)
+	{
+		if (rs->ranges[j].start < start)
+			start = rs->ranges[j].start;
+		if (rs->ranges[j].end > end)
+			end = rs->ranges[j].end;
+	}
+	if (j == i)
+	{
+		/* Nothing to join; make room for a new range. */
+		if (rs->count >= rs->size)
+		{
+			size_t new_size = (rs->size == 0) ? 64 : rs->size * 2;
+			struct pos_range *new_ranges = (struct pos_range *) ecalloc(new_size, sizeof(struct pos_range));
+			if (rs->count > 0)
+				memcpy(new_ranges, rs->ranges, rs->count * sizeof(struct pos_range));
+			free(rs->ranges);
+			rs->ranges = new_ranges;
+			rs->size = new_size;
+		}
+		memmove(&rs->ranges[i+1], &rs->ranges[i], (rs->count - i) * sizeof(struct pos_range));
+		rs->count++;
+	} else if (j > i + 1)
+	{
+		/* Ranges i+1 up to j are joined into range i. */
+		memmove(&rs->ranges[i+1], &rs->ranges[j], (rs->count - j) * sizeof(struct pos_range));
+		rs->count -= j - (i + 1);
+	}
+	rs->ranges[i].start = start;
+	rs->ranges[i].end = end;
+	rs->last = i;
+}
+
+/*
+ * Remove all positions from pos on from a range set.
+ */
+static void cut_ranges(struct range_set *rs, POSITION pos)
+{
+	size_t i = range_find(rs, pos);
+
+	if (i < rs->count && rs->ranges[i].start < pos)
+		rs->ranges[i++].end = pos;
+	rs->count = i;
+	if (rs->last >= rs->count)
+		rs->last = (rs->count > 0) ? rs->count - 1 : 0;
+}
+
+/*
+ * Record a line which has been matched against the filters.
+ * The last line of the file may grow (if it has no newline)
+ * when data is appended to the file, so remember where it is.
+ */
+static void add_filter_range(struct range_set *rs, POSITION linepos, POSITION pos)
+{
+	POSITION len = ch_length();
+
+	add_range(rs, linepos, pos);
+	if ((len == NULL_POSITION || pos >= len) &&
+	    (filter_tail == NULL_POSITION || linepos >= filter_tail))
+	{
+		filter_tail = linepos;
+		filter_tail_end = pos;
+	}
+}
+
+/*
+ * If the file has grown since its last line was matched against
+ * the filters, forget what we know about that line.
+ */
+static void check_filter_tail(void)
+{
+	if (filter_tail == NULL_POSITION || ch_length() == filter_tail_end)
+		return;
+	cut_ranges(&filter_known, filter_tail);
+	cut_ranges(&filter_hidden, filter_tail);
+	filter_tail = NULL_POSITION;
+	/* The prep region must be checked against the filters again. */
+	prep_startpos = prep_endpos = NULL_POSITION;
+}
+
 /*
  * Clear the hilite list.
+ * The node storage is kept, to be reused as the list is rebuilt.
  */
 public void clr_hlist(struct hilite_tree *anchor)
 {
 	struct hilite_storage *hls;
-	struct hilite_storage *nexthls;
 
-	for (hls = anchor->first;  hls != NULL;  hls = nexthls)
-	{
-		nexthls = hls->next;
-		free((void*)hls->nodes);
-		free((void*)hls);
-	}
-	anchor->first = NULL;
-	anchor->current = NULL;
+	for (hls = anchor->first;  hls != NULL;  hls = hls->next)
+		hls->used = 0;
+	anchor->current = anchor->first;
 	anchor->root = NULL;
 
 	anchor->lookaside = NULL;
@@ -414,11 +741,33 @@ public void clr_hlist(struct hilite_tree *anchor)
 public void clr_hilite(void)
 {
 	clr_hlist(&hilite_anchor);
+	clr_line_cache();
 }
 
 public void clr_filter(void)
 {
-	clr_hlist(&filter_anchor);
+	clr_ranges(&filter_hidden);
+	clr_line_cache();
+	clr_ranges(&filter_known);
+	filter_tail = NULL_POSITION;
+	/* The prep region must be checked against the new filters. */
+	prep_startpos = prep_endpos = NULL_POSITION;
+	filter_lines_count = 0;
+	filter_count_pos = ch_zero();
+	filter_count_done = FALSE;
+	clr_match_index();
+}
+
+/*
+ * Forget the positions of the search matches.
+ */
+public void clr_match_index(void)
+{
+	match_lines_count = 0;
+	match_index_pos = ch_zero();
+	match_index_end = NULL_POSITION;
+	match_index_done = FALSE;
+	match_index_cvt_ops = -1;
 }
 
 /*
@@ -543,6 +892,7 @@ public void set_header(POSITION pos)
 		}
 		header_end_pos = pos;
 	}
+	clr_match_index();
 }
 
 /*
@@ -559,14 +909,54 @@ static lbool pos_in_header(POSITION pos)
  */
 public lbool is_filtered(POSITION pos)
 {
-	struct hilite_node *n;
-
 	if (!is_filtering())
 		return (FALSE);
 	if (pos_in_header(pos))
 		return (FALSE);
-	n = hlist_find(&filter_anchor, pos);
-	return (n != NULL && pos >= n->r.hl_startpos);
+	return (in_ranges(&filter_hidden, pos, NULL));
+}
+
+/*
+ * Has the line containing pos already been matched against the filters?
+ */
+static lbool is_filter_known(POSITION pos)
+{
+	return (in_ranges(&filter_known, pos, NULL));
+}
+
+/*
+ * If pos is hidden, return the end of the run of hidden lines
+ * containing it, otherwise just return pos.
+ */
+public POSITION filtered_run_end(POSITION pos)
+{
+	size_t i;
+	POSITION epos;
+
+	if (!is_filtered(pos) || !in_ranges(&filter_hidden, pos, &i))
+		return (pos);
+	epos = filter_hidden.ranges[i].end;
+	/* Header lines are never hidden. */
+	if (header_start_pos != NULL_POSITION && pos < header_start_pos && epos > header_start_pos)
+		epos = header_start_pos;
+	return (epos);
+}
+
+/*
+ * If pos is hidden, return the start of the run of hidden lines
+ * containing it, otherwise just return pos.
+ */
+public POSITION filtered_run_start(POSITION pos)
+{
+	size_t i;
+	POSITION spos;
+
+	if (!is_filtered(pos) || !in_ranges(&filter_hidden, pos, &i))
+		return (pos);
+	spos = filter_hidden.ranges[i].start;
+	if (header_start_pos != NULL_POSITION && pos >= header_end_pos && spos < header_end_pos)
+		spos = header_end_pos;
+	return (spos);
 }
 
 /*
@@ -585,7 +975,7 @@ public POSITION next_unfiltered(POSITION pos)
 		prep_hilite(pos, NULL_POSITION, 1);
 		if (!is_filtered(pos))
 			break;
-		pos = forw_raw_line(pos, NULL, NULL);
+		pos = filtered_run_end(pos);
 	}
 	return pos;
 }
@@ -681,9 +1071,72 @@ public int is_hilited_attr(POSITION pos, POSITION epos, int nohide, int *p_match
 	return (attr);
 }
 
+/*
+ * The earlier of two run ends, where NULL_POSITION means no end.
+ */
+static POSITION earlier_end(POSITION epos, POSITION pos)
+{
+	if (epos == NULL_POSITION || pos < epos)
+		return (pos);
+	return (epos);
+}
+
+/*
+ * Return the highlight attribute of the char at pos, as
+ * is_hilited_attr(pos, pos+1, 0, &matches) would, and set *p_epos
+ * to the end of the run of chars from pos on which have the same
+ * attribute (or NULL_POSITION if the run doesn't end).
+ * This lets a line be highlighted a run at a time, rather than
+ * looking up each char.
+ */
+public int hilited_run_attr(POSITION pos, POSITION *p_epos)
+{
+	struct hilite_node *n;
+	POSITION epos = NULL_POSITION;
+	int attr;
+
+	if (!status_col && start_attnpos != NULL_POSITION && pos <= end_attnpos)
+	{
+		if (pos >= start_attnpos)
+		{
+			*p_epos = end_attnpos + 1;
+			return (AT_HILITE|AT_COLOR_ATTN);
+		}
+		epos = earlier_end(epos, start_attnpos);
+	}
+#if OSC8_LINK
+	if (osc8_linepos != NULL_POSITION && pos < osc8_text_end)
+	{
+		if (pos >= osc8_text_start)
+		{
+			*p_epos = osc8_text_end;
+			return (AT_HILITE|AT_COLOR_SEARCH);
+		}
+		epos = earlier_end(epos, osc8_text_start);
+	}
+#endif
+	n = hlist_find(&hilite_anchor, pos);
+	if (n == NULL)
+		attr = 0;
+	else if (pos < n->r.hl_startpos)
+	{
+		attr = 0;
+		epos = earlier_end(epos, n->r.hl_startpos);
+	} else
+	{
+		attr = n->r.hl_attr;
+		epos = earlier_end(epos, n->r.hl_endpos);
+	}
+	*p_epos = epos;
+	if (hilite_search == 0 || hide_hilite)
+		return (0);
+	return (attr);
+}
+
 /*
  * Tree node storage: get the current block of nodes if it has spare
- * capacity, or create a new one if not.
+ * capacity, or the next one left over from before the list was
+ * cleared, or create a new one if not.
  */
 static struct hilite_storage * hlist_getstorage(struct hilite_tree *anchor)
 {
@@ -694,6 +1147,11 @@ static struct hilite_storage * hlist_getstorage(struct hilite_tree *anchor)
 	{
 		if (anchor->current->used < anchor->current->capacity)
 			return anchor->current;
+		if (anchor->current->next != NULL)
+		{
+			anchor->current = anchor->current->next;
+			return anchor->current;
+		}
 		capacity = anchor->current->capacity * 2;
 	}
 
@@ -716,8 +1174,11 @@ static struct hilite_storage * hlist_getstorage(struct hilite_tree *anchor)
  */
 static struct hilite_node * hlist_getnode(struct hilite_tree *anchor)
 {
+	static struct hilite_node empty_node;
 	struct hilite_storage *s = hlist_getstorage(anchor);
-	return &s->nodes[s->used++];
+	struct hilite_node *n = &s->nodes[s->used++];
+	*n = empty_node;
+	return n;
 }
 
 /*
@@ -1047,7 +1508,7 @@ static void hilite_line(POSITION linepos, constant char *line, size_t line_len,
 			line_off++;
 		else /* end of line */
 			break;
-	} while (match_pattern(info_compiled(&search_info), search_info.text,
+	} while (match_pattern(info_compiled(&search_info), search_info.match_data, search_info.dfa, search_info.text,
 			line, line_len, line_off, sp, ep, nsp, 1, search_info.search_type));
 }
 #endif
@@ -1076,7 +1537,7 @@ public void chg_hilite(void)
 	 * Erase any highlights currently on screen.
 	 */
 	clr_hilite();
-	hide_hilite = FALSE;
+	set_hide_hilite(FALSE);
 
 	if (hilite_search == OPT_ONPLUS)
 		/*
@@ -1186,19 +1647,22 @@ static lbool matches_filters(POSITION pos, char *cline, size_t line_len, int *ch
 {
 	struct pattern_info *filter;
 
+	if (filter_dfa != NULL)
+	{
+		/* Scan the line once for all the filters. */
+		if ((dfa_match_set(filter_dfa, cline, line_len) ^ filter_invert) != 0)
+		{
+			add_filter_range(&filter_hidden, linepos, pos);
+			return (TRUE);
+		}
+		return (FALSE);
+	}
 	for (filter = filter_infos; filter != NULL; filter = filter->next)
 	{
-		lbool line_filter = match_pattern(info_compiled(filter), filter->text,
-			cline, line_len, 0, sp, ep, nsp, 0, filter->search_type);
+		lbool line_filter = match_info(filter, cline, line_len, sp, ep, nsp, filter->search_type);
 		if (line_filter)
 		{
-			struct hilite hl;
-			hl.hl_startpos = linepos;
-			hl.hl_endpos = pos;
-			hl.hl_attr = 0;
-			add_hilite(&filter_anchor, &hl);
-			free(cline);
-			free(chpos);
+			add_filter_range(&filter_hidden, linepos, pos);
 			return (TRUE);
 		}
 	}
@@ -1411,6 +1875,7 @@ static osc8_match osc8_search_line1(int search_type, POSITION linepos, POSITION
 	if (osc8_linepos == linepos && osc8_match_start == spos + ptr_diff(op1.osc8_start, line))
 		return OSC8_ALREADY; /* already selected */
 
+	clr_line_cache();
 	osc8_linepos = linepos;
 	osc8_match_start  = spos + ptr_diff(op1.osc8_start,   line);
 	osc8_match_end    = spos + ptr_diff(op2.osc8_start,   line);
@@ -1479,44 +1944,744 @@ static void osc8_shift_visible(void)
 
 #endif /* OSC8_LINK */
 
+#if PAR_SEARCH
 /*
- * Search a subset of the file, specified by start/end position.
+ * Parallel forward search (--search-threads).
+ * The part of the file to be searched is divided into chunks,
+ * which are read with pread (bypassing the ch.c buffers) and
+ * searched by a pool of threads, each with its own copy of the
+ * compiled pattern.  Each line belongs to the chunk which contains
+ * its first byte.  For each chunk we find the first line which may
+ * match, and count the lines, so search_range can skip from one
+ * candidate line to the next and still know the line number.
+ * search_range reads each candidate line normally, so the threads
+ * only need to find a superset of the lines search_range would accept.
+ * The pool lasts until search_range returns, so a candidate which
+ * search_range rejects (a filtered line, or one of several matches
+ * to be skipped) doesn't start a new search.
  */
-static int search_range(POSITION pos, POSITION endpos, int search_type, int matches, int maxlines, POSITION *plinepos, POSITION *pendpos, POSITION *plastlinepos)
+#if LESSTEST
+/* Small chunks, so that the test files are searched in parallel. */
+#define PAR_CHUNK       256
+#else
+#define PAR_CHUNK       (1024*1024)     /* Bytes per chunk */
+#endif
+#define PAR_MAX_THREADS 256
+#define PAR_AHEAD       2               /* Chunks per thread to search ahead */
+
+/*
+ * Per-thread buffers.
+ */
+struct par_buf
 {
-	constant char *line;
-	char *cline;
-	size_t line_len;
-	LINENUM linenum;
-	#define NSP (NUM_SEARCH_COLORS+2)
-	constant char *sp[NSP];
-	constant char *ep[NSP];
-	lbool line_match;
+	char *data;             /* Data read from the file */
+	size_t size;
+	char *cline;            /* Converted line */
+	size_t csize;
+};
+
+/*
+ * What we found in a chunk.
+ */
+struct par_chunk
+{
+	int state;              /* PAR_WAITING, PAR_BUSY or PAR_DONE */
+	POSITION first;         /* First line in the chunk, or NULL_POSITION */
+	POSITION match;         /* First line which may match, or NULL_POSITION */
+	LINENUM mline;          /* Number of lines in the chunk before match */
+	LINENUM nlines;         /* Number of lines in the chunk */
+	POSITION end;           /* End of the last line in the chunk */
+};
+#define PAR_WAITING     0
+#define PAR_BUSY        1
+#define PAR_DONE        2
+
+struct par_pool;
+
+struct par_worker
+{
+	struct par_pool *pool;
+	struct pattern_info info;  /* Copy of search_info with its own pattern */
+	pthread_t thread;
+};
+
+struct par_pool
+{
+	int fd;
+	POSITION start;         /* Start of first chunk (a line start) */
+	POSITION limit;         /* Lines starting at or after here are not searched */
+	POSITION nchunks;
+	struct par_chunk *chunks;
 	int cvt_ops;
-	size_t cvt_len;
-	int *chpos;
-	POSITION linepos, oldpos;
-	int skip_bytes = 0;
-	size_t swidth = (size_t) (sc_width - line_pfx_width()); /*{{type-issue}}*/
-	size_t sheight = (size_t) (sc_height - sindex_from_sline(jump_sline));
+	int search_type;
+	int nworkers;           /* Threads started (workers[0] is not used) */
+	struct par_worker *workers;
+	struct par_buf buf;     /* Buffers for the main thread */
+	pthread_mutex_t lock;
+	pthread_cond_t cond;    /* Signalled when a chunk is done, or want changes */
+	POSITION next_chunk;    /* Next chunk to be given to a thread */
+	POSITION want;          /* Chunk search_range is waiting for */
+	POSITION ahead;         /* Chunks past want which may be searched */
+	POSITION seen;          /* Last chunk search_range saw was done */
+	lbool failed;           /* Read error, out of memory, or interrupted */
+	lbool quit;             /* search_range is done */
+};
 
-	linenum = find_linenum(pos);
-	if (nosearch_header_lines && linenum <= header_lines)
-	{
-		linenum = header_lines + 1;
-		pos = find_pos(linenum);
-	}
-	if (pos == NULL_POSITION)
+static struct par_pool *par_pool = NULL;
+
+/*
+ * Make sure a buffer is at least a given size.
+ */
+static lbool par_grow(char **pbuf, size_t *psize, size_t size)
+{
+	char *nbuf;
+
+	if (size <= *psize)
+		return (TRUE);
+	nbuf = (char *) realloc(*pbuf, size);
+	if (nbuf == NULL)
+		return (FALSE);
+	*pbuf = nbuf;
+	*psize = size;
+	return (TRUE);
+}
+
+/*
+ * Read up to len bytes at file position pos into pb->data at offset off.
+ * Return the number of bytes read (0 at end of file), or -1 on error.
+ */
+static ssize_t par_read(struct par_pool *pp, struct par_buf *pb, size_t off, POSITION pos, size_t len)
+{
+	size_t got = 0;
+
+	if (!par_grow(&pb->data, &pb->size, off + len))
 		return (-1);
-	oldpos = pos;
-	/* When the search wraps around, end at starting position. */
-	if ((search_type & SRCH_WRAP) && endpos == NULL_POSITION)
-		endpos = pos;
-	flush();
-	for (;;)
+	while (got < len)
 	{
-		/*
-		 * Get lines until we find a matching one or until
+		ssize_t n = pread(pp->fd, pb->data + off + got, len - got, (off_t) (pos + (POSITION) got));
+		if (n < 0)
+		{
+#ifdef EINTR
+			if (errno == EINTR)
+				continue;
+#endif
+			return (-1);
+		}
+		if (n == 0)
+			break;
+		got += (size_t) n;
+	}
+	return ((ssize_t) got);
+}
+
+/*
+ * Should a thread stop searching?
+ */
+static lbool par_stop(struct par_pool *pp)
+{
+	lbool stop;
+
+	if (ABORT_SIGS())
+		return (TRUE);
+	pthread_mutex_lock(&pp->lock);
+	stop = (pp->failed || pp->quit);
+	pthread_mutex_unlock(&pp->lock);
+	return (stop);
+}
+
+/*
+ * Search the lines which start in chunk k, and fill in *c.
+ * Return FALSE if the search failed or should stop.
+ */
+static lbool par_chunk(struct par_pool *pp, struct par_buf *pb, struct pattern_info *info, POSITION k, struct par_chunk *c)
+{
+	POSITION from = pp->start + k * PAR_CHUNK;
+	POSITION to = MINPOS(from + PAR_CHUNK, pp->limit);
+	POSITION bpos;
+	size_t blen;
+	size_t off;
+	ssize_t n;
+	constant char *sp[NUM_SEARCH_COLORS+2];
+	constant char *ep[NUM_SEARCH_COLORS+2];
+
+	c->first = c->match = NULL_POSITION;
+	c->mline = c->nlines = 0;
+	c->end = from;
+	/*
+	 * Read from one byte before the chunk, so we can tell
+	 * whether a line starts at its first byte.
+	 */
+	bpos = (k > 0) ? from - 1 : from;
+	if ((n = par_read(pp, pb, 0, bpos, (size_t) (to - bpos))) < 0)
+		return (FALSE);
+	blen = (size_t) n;
+	off = 0;
+	if (k > 0)
+	{
+		constant char *nl = (constant char *) memchr(pb->data, '\n', blen);
+		if (nl == NULL)
+			/* No line starts in this chunk. */
+			return (TRUE);
+		off = ptr_diff(nl, pb->data) + 1;
+	}
+	if (bpos + (POSITION) off < to)
+		c->first = bpos + (POSITION) off;
+	while (bpos + (POSITION) off < to)
+	{
+		constant char *line;
+		constant char *nl;
+		size_t line_len;
+		size_t cvt_len;
+
+		/*
+		 * Find the end of the line, reading more
+		 * if it extends past what we have read.
+		 */
+		while ((nl = (constant char *) memchr(pb->data + off, '\n', blen - off)) == NULL)
+		{
+			if (off > 0)
+			{
+				memmove(pb->data, pb->data + off, blen - off);
+				bpos += (POSITION) off;
+				blen -= off;
+				off = 0;
+			}
+			if ((n = par_read(pp, pb, blen, bpos + (POSITION) blen, PAR_CHUNK)) < 0)
+				return (FALSE);
+			if (n == 0)
+				break;
+			blen += (size_t) n;
+		}
+		line = pb->data + off;
+		line_len = (nl != NULL) ? ptr_diff(nl, line) : blen - off;
+		if (nl == NULL && line_len == 0)
+			/* End of file. */
+			break;
+
+		/*
+		 * After the first match we only count the lines.
+		 */
+		if (c->match == NULL_POSITION)
+		{
+			cvt_len = cvt_length(line_len, pp->cvt_ops);
+			if (!par_grow(&pb->cline, &pb->csize, cvt_len))
+				return (FALSE);
+			cvt_text(pb->cline, line, NULL, &line_len, pp->cvt_ops);
+			if (match_info(info, pb->cline, line_len, sp, ep, NUM_SEARCH_COLORS+2, pp->search_type))
+			{
+				c->match = bpos + (POSITION) off;
+				c->mline = c->nlines;
+			}
+		}
+		c->nlines++;
+
+		if (nl == NULL)
+		{
+			/* Last line had no newline. */
+			off = blen;
+			break;
+		}
+		off = ptr_diff(nl, pb->data) + 1;
+		if (c->nlines % 1024 == 0 && par_stop(pp))
+			return (FALSE);
+	}
+	c->end = bpos + (POSITION) off;
+	return (TRUE);
+}
+
+/*
+ * Search the next chunk in the queue.
+ * Called, and returns, with the pool locked.
+ */
+static void par_run(struct par_pool *pp, struct par_buf *pb, struct pattern_info *info)
+{
+	POSITION k = pp->next_chunk++;
+	struct par_chunk c;
+	lbool ok;
+
+	pp->chunks[k].state = PAR_BUSY;
+	pthread_mutex_unlock(&pp->lock);
+	ok = par_chunk(pp, pb, info, k, &c);
+	pthread_mutex_lock(&pp->lock);
+	if (!ok || ABORT_SIGS())
+		pp->failed = TRUE;
+	else
+	{
+		c.state = PAR_DONE;
+		pp->chunks[k] = c;
+	}
+	pthread_cond_broadcast(&pp->cond);
+}
+
+/*
+ * Take chunks from the queue and search them, staying no more than
+ * pp->ahead chunks ahead of the one search_range is waiting for.
+ */
+static void * par_thread(void *arg)
+{
+	struct par_worker *w = (struct par_worker *) arg;
+	struct par_pool *pp = w->pool;
+	struct par_buf pb = { NULL, 0, NULL, 0 };
+
+	pthread_mutex_lock(&pp->lock);
+	while (!pp->failed && !pp->quit && pp->next_chunk < pp->nchunks)
+	{
+		if (pp->next_chunk > pp->want + pp->ahead)
+			pthread_cond_wait(&pp->cond, &pp->lock);
+		else
+			par_run(pp, &pb, &w->info);
+	}
+	pthread_mutex_unlock(&pp->lock);
+	free(pb.data);
+	free(pb.cline);
+	return (NULL);
+}
+
+/*
+ * Wait until chunk k has been searched, searching it (and any
+ * chunks before it) in this thread if no other thread has started on it.
+ */
+static lbool par_wait(struct par_pool *pp, POSITION k)
+{
+	lbool ok;
+
+	pthread_mutex_lock(&pp->lock);
+	if (pp->want != k)
+	{
+		pp->want = k;
+		pthread_cond_broadcast(&pp->cond);
+	}
+	while (!pp->failed && pp->chunks[k].state != PAR_DONE)
+	{
+		if (pp->next_chunk <= k)
+			par_run(pp, &pp->buf, &search_info);
+		else
+			pthread_cond_wait(&pp->cond, &pp->lock);
+	}
+	ok = !pp->failed;
+	pthread_mutex_unlock(&pp->lock);
+	return (ok);
+}
+
+/*
+ * Can search_range use par_skip?
+ */
+static lbool par_search_ok(int search_type, int maxlines)
+{
+	if (search_threads < 2 || maxlines >= 0 || nosearch_header_cols)
+		return (FALSE);
+	if ((search_type & (SRCH_FORW|SRCH_BACK|SRCH_FIND_ALL|SRCH_NO_MATCH)) != SRCH_FORW)
+		return (FALSE);
+#if OSC8_LINK
+	if (search_type & SRCH_OSC8)
+		return (FALSE);
+#endif
+	if (!prev_pattern(&search_info))
+		return (FALSE);
+	/* The DFA matcher caches states, so can't be shared by threads. */
+	if (search_info.dfa != NULL)
+		return (FALSE);
+	return ((ch_getflags() & (CH_CANSEEK|CH_HELPFILE)) == CH_CANSEEK);
+}
+
+/*
+ * Compile a copy of the search pattern for another thread.
+ * Matchers like glibc's regexec lock the pattern while they use it,
+ * so threads sharing one pattern would take turns.
+ */
+static lbool par_compile(struct pattern_info *info)
+{
+	*info = search_info;
+	info->next = NULL;
+#if !NO_REGEX
+	{
+		int save_caseless = is_caseless;
+		int r;
+
+		SET_NULL_PATTERN(info->compiled);
+		SET_NULL_PATTERN(info->block_compiled);
+		info->match_data = NULL;
+		info->block_match_data = NULL;
+		/* Compile it the way set_pattern compiled search_info. */
+		is_caseless = info->is_caseless;
+		r = compile_pattern(search_info.text, search_info.search_type, 0, &info->compiled, &info->match_data);
+		is_caseless = save_caseless;
+		if (r < 0)
+			return (FALSE);
+	}
+#endif
+	return (TRUE);
+}
+
+/*
+ * Stop the pool's threads and free the pool.
+ */
+static void par_end(void)
+{
+	struct par_pool *pp = par_pool;
+	int i;
+
+	if (pp == NULL)
+		return;
+	par_pool = NULL;
+	pthread_mutex_lock(&pp->lock);
+	pp->quit = TRUE;
+	pthread_cond_broadcast(&pp->cond);
+	pthread_mutex_unlock(&pp->lock);
+	for (i = 1;  i < pp->nworkers;  i++)
+	{
+		pthread_join(pp->workers[i].thread, NULL);
+#if !NO_REGEX
+		uncompile_pattern(&pp->workers[i].info.compiled, &pp->workers[i].info.match_data);
+#endif
+	}
+	pthread_cond_destroy(&pp->cond);
+	pthread_mutex_destroy(&pp->lock);
+	free(pp->buf.data);
+	free(pp->buf.cline);
+	free(pp->workers);
+	free(pp->chunks);
+	free(pp);
+}
+
+/*
+ * Start a pool of threads searching forward from pos,
+ * which is the start of a line.
+ */
+static struct par_pool * par_begin(POSITION pos, POSITION endpos, int search_type)
+{
+	struct par_pool *pp;
+	sigset_t mask, omask;
+	POSITION limit;
+	int nthreads;
+	int i;
+
+	limit = ch_length();
+	if (limit == NULL_POSITION)
+		return (NULL);
+	if (endpos != NULL_POSITION && !(search_type & SRCH_WRAP) && endpos < limit)
+		limit = endpos;
+	if (limit - pos <= PAR_CHUNK)
+		/* Not worth it. */
+		return (NULL);
+	if (ch_getfd() < 0)
+		return (NULL);
+	pp = (struct par_pool *) ecalloc(1, sizeof(struct par_pool));
+	pp->fd = ch_getfd();
+	pp->start = pos;
+	pp->limit = limit;
+	pp->nchunks = (limit - pos + PAR_CHUNK - 1) / PAR_CHUNK;
+	pp->chunks = (struct par_chunk *) ecalloc((size_t) pp->nchunks, sizeof(struct par_chunk));
+	pp->search_type = search_type;
+	pp->cvt_ops = get_cvt_ops(search_type);
+	pp->next_chunk = 0;
+	pp->want = 0;
+	pp->seen = -1;
+	pp->failed = pp->quit = FALSE;
+	if (pthread_mutex_init(&pp->lock, NULL) != 0)
+	{
+		free(pp->chunks);
+		free(pp);
+		return (NULL);
+	}
+	if (pthread_cond_init(&pp->cond, NULL) != 0)
+	{
+		pthread_mutex_destroy(&pp->lock);
+		free(pp->chunks);
+		free(pp);
+		return (NULL);
+	}
+
+	nthreads = search_threads;
+	if (nthreads > PAR_MAX_THREADS)
+		nthreads = PAR_MAX_THREADS;
+	if ((POSITION) nthreads > pp->nchunks)
+		nthreads = (int) pp->nchunks;
+	pp->ahead = (POSITION) nthreads * PAR_AHEAD;
+	/*
+	 * This thread does its share of the work too, while it waits
+	 * for a chunk, so start one fewer new threads.
+	 * The new threads block all signals, so that they
+	 * are always handled by this thread.
+	 */
+	pp->workers = (struct par_worker *) ecalloc((size_t) nthreads, sizeof(struct par_worker));
+	sigfillset(&mask);
+	pthread_sigmask(SIG_SETMASK, &mask, &omask);
+	for (i = 1;  i < nthreads;  i++)
+	{
+		struct par_worker *w = &pp->workers[i];
+		w->pool = pp;
+		if (!par_compile(&w->info))
+			break;
+		if (pthread_create(&w->thread, NULL, par_thread, w) != 0)
+		{
+#if !NO_REGEX
+			uncompile_pattern(&w->info.compiled, &w->info.match_data);
+#endif
+			break;
+		}
+	}
+	pthread_sigmask(SIG_SETMASK, &omask, NULL);
+	pp->nworkers = i;
+	return (pp);
+}
+
+/*
+ * Find the next line, at or after pos, which may match.
+ * pos is the start of a line, whose number is *plinenum (or 0 if unknown);
+ * *plinenum is updated to the number of the returned line.
+ * Return NULL_POSITION if the search should be done normally instead.
+ */
+static POSITION par_skip(POSITION pos, POSITION endpos, int search_type, LINENUM *plinenum)
+{
+	struct par_pool *pp = par_pool;
+
+	if (pp != NULL && pos < pp->start)
+	{
+		/* The search has wrapped to the start of the file. */
+		par_end();
+		pp = NULL;
+	}
+	if (pp == NULL)
+	{
+		if ((pp = par_begin(pos, endpos, search_type)) == NULL)
+			return (NULL_POSITION);
+		par_pool = pp;
+	}
+	for (;;)
+	{
+		POSITION k;
+		struct par_chunk *c;
+
+		if (pos >= pp->limit)
+			return (pos);
+		k = (pos - pp->start) / PAR_CHUNK;
+		if (k != pp->seen)
+		{
+			if (!par_wait(pp, k))
+				return (NULL_POSITION);
+			pp->seen = k;
+		}
+		c = &pp->chunks[k];
+		if (pos != c->first)
+			/* 
+			 * We're past the first candidate in this chunk:
+			 * search the rest of it line by line.
+			 */
+			return (pos);
+		if (c->match != NULL_POSITION)
+		{
+			if (*plinenum != 0)
+				*plinenum += c->mline;
+			return (c->match);
+		}
+		if (*plinenum != 0)
+			*plinenum += c->nlines;
+		pos = c->end;
+	}
+}
+#endif /* PAR_SEARCH */
+
+/*
+ * Buffers for the converted text and position map of the line
+ * being searched.  They are reused for every line and only grow,
+ * so most lines need no memory allocation.
+ */
+static char *search_cline = NULL;
+static int *search_chpos = NULL;
+static size_t search_cvt_size = 0;
+
+/*
+ * Get buffers big enough to convert a line of the given length.
+ */
+static void get_cvt_buffers(size_t len, char **pcline, int **pchpos)
+{
+	if (len > search_cvt_size)
+	{
+		size_t size = (search_cvt_size > 0) ? search_cvt_size : 1024;
+		while (size < len)
+			size *= 2;
+		free(search_cline);
+		free(search_chpos);
+		search_cline = (char *) ecalloc(size, sizeof(char));
+		search_chpos = (int *) ecalloc(size, sizeof(int));
+		search_cvt_size = size;
+	}
+	*pcline = search_cline;
+	*pchpos = search_chpos;
+}
+
+/*
+ * Make the chpos array for a line which did not need conversion.
+ * Like cvt_text, mark the end of the text with -1.
+ */
+static int * identity_chpos(size_t len)
+{
+	char *cline;
+	int *chpos;
+	size_t i;
+
+	get_cvt_buffers(len + 1, &cline, &chpos);
+	for (i = 0;  i < len;  i++)
+		chpos[i] = (int) i; /*{{type-issue}}*/
+	chpos[len] = -1;
+	return (chpos);
+}
+
+#if !NO_REGEX
+/*
+ * Should search_range look for matches in whole blocks of lines?
+ */
+static lbool block_search_ok(int search_type, int maxlines)
+{
+	if (maxlines >= 0 || nosearch_header_cols)
+		return (FALSE);
+	if ((search_type & (SRCH_FORW|SRCH_BACK|SRCH_FIND_ALL|SRCH_NO_MATCH)) != SRCH_FORW)
+		return (FALSE);
+#if OSC8_LINK
+	if (search_type & SRCH_OSC8)
+		return (FALSE);
+#endif
+	if (!prev_pattern(&search_info))
+		return (FALSE);
+	return (!is_null_pattern(search_info.block_compiled));
+}
+
+/*
+ * Search forward from pos, which is the start of a line, through
+ * the file data which is already in memory, matching the pattern
+ * against many lines at once rather than one line at a time.
+ * Return the position of the first line which may match, or if there
+ * is none, the position just after the last line searched.
+ * In either case, set *pnext to the position where block searching
+ * may resume, and update *plinenum if it is known.
+ */
+static POSITION block_search(POSITION pos, POSITION endpos, int cvt_ops, LINENUM *plinenum, POSITION *pnext)
+{
+	constant char *block;
+	constant char *end;
+	constant char *start;
+	constant char *p;
+	size_t len;
+	size_t off;
+
+	*pnext = pos;
+	if (ch_seek(pos) != 0)
+		return (pos);
+	block = (constant char *) ch_forw_span(&len);
+	if (block == NULL)
+		return (pos);
+	if (len > BLOCK_SEARCH_SIZE)
+		len = BLOCK_SEARCH_SIZE;
+	if (endpos != NULL_POSITION && (POSITION) len > endpos - pos)
+		len = (size_t) (endpos - pos);
+	/*
+	 * Use only complete lines, and only if they need no conversion,
+	 * so the pattern sees exactly what it would see line by line.
+	 * Otherwise, the caller should search these lines normally.
+	 */
+	end = block + len;
+	while (end > block && end[-1] != '\n')
+		end--;
+	if (end == block)
+		return (pos);
+	len = ptr_diff(end, block);
+	if (!cvt_is_identity(block, len, cvt_ops & ~CVT_CRLF) ||
+	    ((cvt_ops & CVT_CRLF) && memchr(block, '\r', len) != NULL))
+	{
+		*pnext = pos + (POSITION) len;
+		return (pos);
+	}
+	/*
+	 * Start matching at the line containing the first occurrence
+	 * of the literal string, if the pattern has one.
+	 */
+	start = block;
+	if (search_info.literal != NULL)
+	{
+		for (p = block;  ;  p++)
+		{
+			if ((size_t) (end - p) < search_info.literal_len ||
+			    (p = (constant char *) memchr(p, search_info.literal[0], (size_t) (end - p) - search_info.literal_len + 1)) == NULL)
+			{
+				start = end;
+				break;
+			}
+			if (memcmp(p, search_info.literal, search_info.literal_len) == 0)
+			{
+				while (p > block && p[-1] != '\n')
+					p--;
+				start = p;
+				break;
+			}
+		}
+	}
+	if (start < end && match_block(search_info.block_compiled, search_info.block_match_data, start, ptr_diff(end, start), &off))
+	{
+		start += off;
+		while (start > block && start[-1] != '\n')
+			start--;
+		*pnext = pos + (POSITION) ptr_diff(start, block) + 1;
+	} else
+	{
+		start = end;
+		*pnext = pos + (POSITION) len;
+	}
+	if (*plinenum != 0)
+	{
+		for (p = block;  (p = (constant char *) memchr(p, '\n', ptr_diff(start, p))) != NULL;  p++)
+			(*plinenum)++;
+	}
+	return (pos + (POSITION) ptr_diff(start, block));
+}
+#endif
+
+/*
+ * Search a subset of the file, specified by start/end position.
+ */
+static int search_range1(POSITION pos, POSITION endpos, int search_type, int matches, int maxlines, POSITION *plinepos, POSITION *pendpos, POSITION *plastlinepos)
+{
+	constant char *line;
+	char *cline;
+	size_t line_len;
+	LINENUM linenum;
+	#define NSP (NUM_SEARCH_COLORS+2)
+	constant char *sp[NSP];
+	constant char *ep[NSP];
+	lbool line_match;
+	int cvt_ops;
+	size_t cvt_len;
+	int *chpos;
+	POSITION linepos, oldpos;
+	int skip_bytes = 0;
+	size_t swidth = (size_t) (sc_width - line_pfx_width()); /*{{type-issue}}*/
+	size_t sheight = (size_t) (sc_height - sindex_from_sline(jump_sline));
+#if PAR_SEARCH
+	lbool par_ok = par_search_ok(search_type, maxlines);
+	POSITION par_next = NULL_POSITION; /* Line found by par_skip */
+#endif
+#if !NO_REGEX
+	lbool block_ok = block_search_ok(search_type, maxlines);
+	POSITION block_next = NULL_POSITION; /* Where block_search may resume */
+#endif
+
+	linenum = find_linenum(pos);
+	if (nosearch_header_lines && linenum <= header_lines)
+	{
+		linenum = header_lines + 1;
+		pos = find_pos(linenum);
+	}
+	if (pos == NULL_POSITION)
+		return (-1);
+	oldpos = pos;
+	/* When the search wraps around, end at starting position. */
+	if ((search_type & SRCH_WRAP) && endpos == NULL_POSITION)
+		endpos = pos;
+	flush();
+	for (;;)
+	{
+		/*
+		 * Get lines until we find a matching one or until
 		 * we hit end-of-file (or beginning-of-file if we're 
 		 * going backwards), or until we hit the end position.
 		 */
@@ -1542,6 +2707,39 @@ static int search_range(POSITION pos, POSITION endpos, int search_type, int matc
 		if (maxlines > 0)
 			maxlines--;
 
+#if PAR_SEARCH
+		if (par_ok && pos != par_next)
+		{
+			/*
+			 * Skip ahead to the next line which may match.
+			 */
+			POSITION npos = par_skip(pos, endpos, search_type, &linenum);
+			if (npos == NULL_POSITION)
+				par_ok = FALSE;
+			else if (npos != pos)
+			{
+				pos = par_next = npos;
+				continue;
+			}
+		}
+#endif
+#if !NO_REGEX
+		if (block_ok && (block_next == NULL_POSITION || pos >= block_next)
+#if PAR_SEARCH
+		    && !par_ok
+#endif
+		    )
+		{
+			POSITION npos = block_search(pos,
+				(search_type & SRCH_WRAP) ? NULL_POSITION : endpos,
+				get_cvt_ops(search_type), &linenum, &block_next);
+			if (npos != pos)
+			{
+				pos = npos;
+				continue;
+			}
+		}
+#endif
 		if (search_type & SRCH_FORW)
 		{
 			/*
@@ -1596,6 +2794,9 @@ static int search_range(POSITION pos, POSITION endpos, int search_type, int matc
 					search_wrapped = TRUE;
 					search_type &= ~SRCH_WRAP;
 					linenum = find_linenum(pos);
+#if !NO_REGEX
+					block_next = NULL_POSITION;
+#endif
 					continue;
 				}
 			}
@@ -1612,7 +2813,7 @@ static int search_range(POSITION pos, POSITION endpos, int search_type, int matc
 		 * the search.  Remember the line number only if
 		 * we're "far" from the last place we remembered it.
 		 */
-		if (linenums && abs((int)(pos - oldpos)) > 2048)
+		if (linenums && linenum != 0 && abs((int)(pos - oldpos)) > 2048)
 			add_lnum(linenum, pos);
 		oldpos = pos;
 
@@ -1640,19 +2841,30 @@ static int search_range(POSITION pos, POSITION endpos, int search_type, int matc
 		 * If we're doing backspace processing, delete backspaces.
 		 */
 		cvt_ops = get_cvt_ops(search_type);
-		cvt_len = cvt_length(line_len, cvt_ops);
-		cline = (char *) ecalloc(1, cvt_len);
-		chpos = cvt_alloc_chpos(cvt_len);
-		cvt_text(cline, line, chpos, &line_len, cvt_ops);
+		if (cvt_is_identity(line, line_len, cvt_ops))
+		{
+			/*
+			 * No conversion needed; match against the line itself.
+			 * The chpos array is only made if there is a match.
+			 */
+			cline = (char *) line;
+			chpos = NULL;
+		} else
+		{
+			cvt_len = cvt_length(line_len, cvt_ops);
+			get_cvt_buffers(cvt_len, &cline, &chpos);
+			cvt_text(cline, line, chpos, &line_len, cvt_ops);
+		}
 
 #if HILITE_SEARCH
 		/*
 		 * If any filters are in effect, ignore non-matching lines.
+		 * Lines which have been checked before are remembered,
+		 * and any hidden ones were skipped above.
 		 */
-		if (filter_infos != NULL &&
-		   ((search_type & SRCH_FIND_ALL) ||
-		     prep_startpos == NULL_POSITION ||
-		     linepos < prep_startpos || linepos >= prep_endpos)) {
+		if (filter_infos != NULL && !is_filter_known(linepos))
+		{
+			add_filter_range(&filter_known, linepos, pos);
 			if (matches_filters(pos, cline, line_len, chpos, linepos, sp, ep, NSP))
 				continue;
 		}
@@ -1665,13 +2877,14 @@ static int search_range(POSITION pos, POSITION endpos, int search_type, int matc
 		 */
 		if (prev_pattern(&search_info))
 		{
-			line_match = match_pattern(info_compiled(&search_info), search_info.text,
-				cline, line_len, 0, sp, ep, NSP, 0, search_type);
+			line_match = match_info(&search_info, cline, line_len, sp, ep, NSP, search_type);
 			if (line_match)
 			{
 				/*
 				 * Got a match.
 				 */
+				if (chpos == NULL)
+					chpos = identity_chpos(line_len);
 				if (search_type & SRCH_FIND_ALL)
 				{
 #if HILITE_SEARCH
@@ -1728,19 +2941,27 @@ static int search_range(POSITION pos, POSITION endpos, int search_type, int matc
 								*plastlinepos = get_lastlinepos(linepos, linepos + chpos[end_off], (int) sheight);
 						}
 					}
-					free(cline);
-					free(chpos);
 					if (plinepos != NULL)
 						*plinepos = linepos;
 					return (0);
 				}
 			}
 		}
-		free(cline);
-		free(chpos);
 	}
 }
 
+/*
+ * Like search_range1, but also stop any search threads it started.
+ */
+static int search_range(POSITION pos, POSITION endpos, int search_type, int matches, int maxlines, POSITION *plinepos, POSITION *pendpos, POSITION *plastlinepos)
+{
+	int r = search_range1(pos, endpos, search_type, matches, maxlines, plinepos, pendpos, plastlinepos);
+#if PAR_SEARCH
+	par_end();
+#endif
+	return (r);
+}
+
 #if OSC8_LINK
 
 /*
@@ -1995,6 +3216,9 @@ static int hist_pattern(int search_type)
 	if (pattern == NULL)
 		return (0);
 
+#if HILITE_SEARCH
+	clr_match_index();
+#endif
 	if (set_pattern(&search_info, pattern, search_type, 1) < 0)
 		return (-1);
 
@@ -2037,6 +3261,33 @@ public void chg_caseless(void)
 	(void) hist_pattern(search_info.search_type);
 }
 
+#if HILITE_SEARCH
+/*
+ * Prepare the highlights before searching again for the previous pattern.
+ */
+static void repeat_hilite(void)
+{
+	if (hilite_search == OPT_ON || status_col)
+	{
+		/*
+		 * Erase the highlights currently on screen.
+		 * If the search fails, we'll redisplay them later.
+		 */
+		repaint_hilite(FALSE);
+	}
+	if (hilite_search == OPT_ONPLUS && hide_hilite)
+	{
+		/*
+		 * Highlight any matches currently on screen,
+		 * before we actually start the search.
+		 */
+		set_hide_hilite(FALSE);
+		hilite_screen();
+	}
+	set_hide_hilite(FALSE);
+}
+#endif
+
 /*
  * Search for the n-th occurrence of a specified pattern, 
  * either forward or backward.
@@ -2066,31 +3317,14 @@ public int search(int search_type, constant char *pattern, int n)
 			if (r <= 0)
 				return (-1);
 		}
-		if ((search_type & SRCH_NO_REGEX) != 
-		      (search_info.search_type & SRCH_NO_REGEX))
-		{
-			error("Please re-enter search pattern", NULL_PARG);
-			return -1;
-		}
-#if HILITE_SEARCH
-		if (hilite_search == OPT_ON || status_col)
-		{
-			/*
-			 * Erase the highlights currently on screen.
-			 * If the search fails, we'll redisplay them later.
-			 */
-			repaint_hilite(FALSE);
-		}
-		if (hilite_search == OPT_ONPLUS && hide_hilite)
+		if ((search_type & SRCH_NO_REGEX) != 
+		      (search_info.search_type & SRCH_NO_REGEX))
 		{
-			/*
-			 * Highlight any matches currently on screen,
-			 * before we actually start the search.
-			 */
-			hide_hilite = FALSE;
-			hilite_screen();
+			error("Please re-enter search pattern", NULL_PARG);
+			return -1;
 		}
-		hide_hilite = FALSE;
+#if HILITE_SEARCH
+		repeat_hilite();
 #endif
 	} else
 	{
@@ -2098,6 +3332,9 @@ public int search(int search_type, constant char *pattern, int n)
 		 * Compile the pattern.
 		 */
 		int show_error = !(search_type & SRCH_INCR);
+#if HILITE_SEARCH
+		clr_match_index();
+#endif
 		if (set_pattern(&search_info, pattern, search_type, show_error) < 0)
 			return (-1);
 #if HILITE_SEARCH
@@ -2108,7 +3345,7 @@ public int search(int search_type, constant char *pattern, int n)
 			 * Also permanently delete them from the hilite list.
 			 */
 			repaint_hilite(FALSE);
-			hide_hilite = FALSE;
+			set_hide_hilite(FALSE);
 			clr_hilite();
 		}
 		if (hilite_search == OPT_ONPLUS || status_col)
@@ -2143,6 +3380,10 @@ public int search(int search_type, constant char *pattern, int n)
 		return (-1);
 	}
 
+#if HILITE_SEARCH
+	check_filter_tail();
+	if (!indexed_search(pos, search_type, &n, &pos, &lastlinepos))
+#endif
 	n = search_range(pos, NULL_POSITION, search_type, n, -1,
 			&pos, (POSITION*)NULL, &lastlinepos);
 	/*
@@ -2202,8 +3443,8 @@ public int search(int search_type, constant char *pattern, int n)
  */
 public void prep_hilite(POSITION spos, POSITION epos, int maxlines)
 {
-	POSITION nprep_startpos = prep_startpos;
-	POSITION nprep_endpos = prep_endpos;
+	POSITION nprep_startpos;
+	POSITION nprep_endpos;
 	POSITION new_epos;
 	POSITION max_epos;
 	int result;
@@ -2211,6 +3452,9 @@ public void prep_hilite(POSITION spos, POSITION epos, int maxlines)
 
 	if (!prev_pattern(&search_info) && !is_filtering())
 		return;
+	check_filter_tail();
+	nprep_startpos = prep_startpos;
+	nprep_endpos = prep_endpos;
 
 	/*
 	 * Make sure our prep region always starts at the beginning of
@@ -2246,9 +3490,11 @@ public void prep_hilite(POSITION spos, POSITION epos, int maxlines)
 		/*
 		 * New range is not contiguous with old prep region.
 		 * Discard the old prep region and start a new one.
+		 * Filtered lines are kept; they do not depend on the region.
+		 * Cached lines keep their hilites too, since preparing
+		 * their region again would find the same ones.
 		 */
-		clr_hilite();
-		clr_filter();
+		clr_hlist(&hilite_anchor);
 		nprep_startpos = nprep_endpos = spos;
 	} else
 	{
@@ -2303,8 +3549,9 @@ public void prep_hilite(POSITION spos, POSITION epos, int maxlines)
 			{
 				if (new_epos >= nprep_endpos && is_filtered(new_epos-1))
 				{
-					spos = nprep_endpos;
-					epos = forw_raw_line(nprep_endpos, NULL, NULL);
+					/* Skip any lines already known to be hidden. */
+					spos = nprep_endpos = filtered_run_end(nprep_endpos);
+					epos = forw_raw_line(spos, NULL, NULL);
 					if (epos == NULL_POSITION)
 						break;
 					maxlines = 1;
@@ -2317,7 +3564,7 @@ public void prep_hilite(POSITION spos, POSITION epos, int maxlines)
 			{
 				if (nprep_startpos > 0 && is_filtered(nprep_startpos))
 				{
-					epos = nprep_startpos;
+					epos = nprep_startpos = filtered_run_start(nprep_startpos);
 					spos = back_raw_line(nprep_startpos, NULL, NULL);
 					if (spos == NULL_POSITION)
 						break;
@@ -2333,6 +3580,36 @@ public void prep_hilite(POSITION spos, POSITION epos, int maxlines)
 	prep_endpos = nprep_endpos;
 }
 
+/*
+ * If every filter uses the DFA matcher, compile them all into
+ * one DFA, so that each line need be scanned only once.
+ */
+static void set_filter_dfa(void)
+{
+	constant char *patterns[FILTER_DFA_MAX];
+	lbool caseless[FILTER_DFA_MAX];
+	struct pattern_info *filter;
+	constant char *errmsg;
+	int n = 0;
+
+	uncompile_dfa_pattern(&filter_dfa);
+	filter_invert = 0;
+	for (filter = filter_infos; filter != NULL; filter = filter->next)
+	{
+		if (filter->dfa == NULL || (filter->search_type & SRCH_SUBSEARCH_ALL) ||
+		    n >= FILTER_DFA_MAX)
+			return;
+		patterns[n] = filter->text;
+		caseless[n] = filter->is_caseless;
+		if (filter->search_type & SRCH_NO_MATCH)
+			filter_invert |= 1U << n;
+		n++;
+	}
+	if (n < 2)
+		return;
+	filter_dfa = dfa_compile_set(patterns, caseless, n, &errmsg);
+}
+
 /*
  * Set the pattern to be used for line filtering.
  */
@@ -2365,6 +3642,7 @@ public void set_filter_pattern(constant char *pattern, int search_type)
 		filter->next = filter_infos;
 		filter_infos = filter;
 	}
+	set_filter_dfa();
 	screen_trashed();
 }
 
@@ -2377,6 +3655,477 @@ public lbool is_filtering(void)
 		return (FALSE);
 	return (filter_infos != NULL);
 }
+
+/*
+ * Match a line against the filters, unless that has been done already.
+ */
+static void filter_line(POSITION linepos, POSITION pos, constant char *line, size_t line_len)
+{
+	constant char *sp[NUM_SEARCH_COLORS+2];
+	constant char *ep[NUM_SEARCH_COLORS+2];
+	char *cline;
+	int *chpos;
+	int cvt_ops;
+
+	if (is_filter_known(linepos))
+		return;
+	if (nosearch_header_cols)
+		(void) skip_columns(header_cols, &line, &line_len);
+	cvt_ops = get_cvt_ops(SRCH_FORW | (search_info.search_type & SRCH_NO_REGEX));
+	if (cvt_is_identity(line, line_len, cvt_ops))
+	{
+		cline = (char *) line;
+		chpos = NULL;
+	} else
+	{
+		get_cvt_buffers(cvt_length(line_len, cvt_ops), &cline, &chpos);
+		cvt_text(cline, line, chpos, &line_len, cvt_ops);
+	}
+	add_filter_range(&filter_known, linepos, pos);
+	(void) matches_filters(pos, cline, line_len, chpos, linepos, sp, ep, NUM_SEARCH_COLORS+2);
+}
+
+/*
+ * Append a line position to a growable array.
+ */
+static void add_line_pos(POSITION **plines, size_t *pcount, size_t *psize, POSITION pos)
+{
+	if (*pcount >= *psize)
+	{
+		size_t new_size = (*psize == 0) ? 1024 : *psize * 2;
+		POSITION *new_lines = (POSITION *) ecalloc(new_size, sizeof(POSITION));
+		if (*pcount > 0)
+			memcpy(new_lines, *plines, *pcount * sizeof(POSITION));
+		free(*plines);
+		*plines = new_lines;
+		*psize = new_size;
+	}
+	(*plines)[(*pcount)++] = pos;
+}
+
+/*
+ * Check the next piece of the file against the filters,
+ * and remember the positions of the lines which are shown.
+ * Return FALSE when there is nothing more to check.
+ */
+static lbool count_filter_step(void)
+{
+	POSITION pos = filter_count_pos;
+	POSITION epos = pos + FILTER_COUNT_CHUNK;
+	POSITION linepos;
+	constant char *line;
+	size_t line_len;
+
+	if (!is_filtering() || filter_count_done)
+		return (FALSE);
+	check_filter_tail();
+	while (pos < epos)
+	{
+		linepos = pos;
+		if (is_filtered(linepos))
+		{
+			/* Skip lines already known to be hidden. */
+			pos = filtered_run_end(linepos);
+			continue;
+		}
+		pos = forw_raw_line(linepos, &line, &line_len);
+		if (pos == NULL_POSITION)
+		{
+			/* Reached end of file. */
+			filter_count_done = TRUE;
+			pos = linepos;
+			break;
+		}
+		if (ABORT_SIGS())
+		{
+			filter_count_pos = linepos;
+			return (FALSE);
+		}
+		filter_line(linepos, pos, line, line_len);
+		if (is_filtered(linepos))
+			continue;
+		add_line_pos(&filter_lines, &filter_lines_count, &filter_lines_size, linepos);
+	}
+	filter_count_pos = pos;
+	return (!filter_count_done);
+}
+
+/*
+ * Is count_filter_lines still counting the lines shown by the filters?
+ */
+public lbool counting_filter_lines(void)
+{
+	if (!filter_count || !is_filtering() || filter_count_done)
+		return (FALSE);
+	return ((ch_getflags() & CH_CANSEEK) != 0);
+}
+
+/*
+ * Count the lines shown by the filters in the next piece of the file
+ * (--filter-count).
+ * Return FALSE when there is nothing more to count.
+ */
+public lbool count_filter_lines(void)
+{
+	if (!counting_filter_lines())
+		return (FALSE);
+	return (count_filter_step());
+}
+
+/*
+ * Return the number of lines shown by the filters, 
+ * and set *pdone to whether the whole file has been counted.
+ * Return -1 if nothing has been counted.
+ */
+public LINENUM filter_line_count(lbool *pdone)
+{
+	if (!is_filtering() || (filter_lines_count == 0 && !filter_count_done))
+		return (-1);
+	if (pdone != NULL)
+		*pdone = filter_count_done;
+	return ((LINENUM) filter_lines_count);
+}
+
+/*
+ * Return the position of the n-th line shown by the filters,
+ * counting lines as necessary, or NULL_POSITION if there are 
+ * not that many.
+ */
+public POSITION filter_line_pos(LINENUM n)
+{
+	while ((LINENUM) filter_lines_count < n)
+	{
+		if (!count_filter_step())
+			break;
+	}
+	if (n < 1 || (LINENUM) filter_lines_count < n)
+		return (NULL_POSITION);
+	return (filter_lines[n-1]);
+}
+
+/*
+ * Forget the match index if it was built with
+ * different text conversions than searches now use.
+ */
+static void check_match_index(void)
+{
+	int cvt_ops = get_cvt_ops(search_info.search_type);
+	if (cvt_ops != match_index_cvt_ops)
+	{
+		clr_match_index();
+		match_index_cvt_ops = cvt_ops;
+	}
+}
+
+/*
+ * Has the whole file been searched for the match index?
+ * If the file has grown since, it hasn't; forget the last line
+ * if it was incomplete, so it is searched again.
+ */
+static lbool match_index_complete(void)
+{
+	if (match_index_done && ch_length() != match_index_end)
+	{
+		match_index_done = FALSE;
+		while (match_lines_count > 0 && 
+		       match_lines[match_lines_count-1] >= match_index_pos)
+			match_lines_count--;
+	}
+	return (match_index_done);
+}
+
+/*
+ * Is the line which ends at pos the last line of the file,
+ * without a newline at the end?
+ */
+static lbool partial_last_line(POSITION pos)
+{
+	POSITION len = ch_length();
+
+	if (len != NULL_POSITION && pos < len)
+		return (FALSE);
+	if (pos == ch_zero() || ch_seek(pos - 1))
+		return (FALSE);
+	return (ch_forw_get() != '\n');
+}
+
+/*
+ * Search the next piece of the file for the search pattern,
+ * and remember the positions of the matching lines.
+ * Lines are checked the same way as a forward search checks them.
+ * Return FALSE when there is nothing more to search.
+ */
+static lbool index_match_step(void)
+{
+	POSITION pos;
+	POSITION epos;
+	POSITION linepos;
+	POSITION partpos = NULL_POSITION;
+	constant char *line;
+	size_t line_len;
+	char *cline;
+	int *chpos;
+	constant char *sp[NUM_SEARCH_COLORS+2];
+	constant char *ep[NUM_SEARCH_COLORS+2];
+
+	if (!prev_pattern(&search_info))
+		return (FALSE);
+	check_match_index();
+	if (match_index_complete())
+		return (FALSE);
+	check_filter_tail();
+	pos = match_index_pos;
+	epos = pos + MATCH_INDEX_CHUNK;
+	while (pos < epos)
+	{
+		linepos = pos;
+		if (is_filtered(linepos))
+		{
+			pos = filtered_run_end(linepos);
+			continue;
+		}
+		pos = forw_raw_line(linepos, &line, &line_len);
+		if (pos == NULL_POSITION)
+		{
+			/* Reached end of file. */
+			match_index_done = TRUE;
+			match_index_end = linepos;
+			pos = linepos;
+			break;
+		}
+		if (ABORT_SIGS())
+		{
+			match_index_pos = linepos;
+			return (FALSE);
+		}
+		if (partial_last_line(pos))
+		{
+			/* Index it, but stop at its start. */
+			partpos = linepos;
+			epos = pos;
+		}
+		if (nosearch_header_lines && pos_in_header(linepos))
+			continue;
+		if (filter_infos != NULL)
+		{
+			filter_line(linepos, pos, line, line_len);
+			if (is_filtered(linepos))
+				continue;
+		}
+		if (nosearch_header_cols)
+			(void) skip_columns(header_cols, &line, &line_len);
+		if (cvt_is_identity(line, line_len, match_index_cvt_ops))
+		{
+			cline = (char *) line;
+			chpos = NULL;
+		} else
+		{
+			get_cvt_buffers(cvt_length(line_len, match_index_cvt_ops), &cline, &chpos);
+			cvt_text(cline, line, chpos, &line_len, match_index_cvt_ops);
+		}
+		if (match_info(&search_info, cline, line_len, sp, ep, NUM_SEARCH_COLORS+2, search_info.search_type))
+			add_line_pos(&match_lines, &match_lines_count, &match_lines_size, linepos);
+	}
+	if (partpos != NULL_POSITION)
+	{
+		match_index_done = TRUE;
+		match_index_end = pos;
+		pos = partpos;
+	}
+	match_index_pos = pos;
+	return (!match_index_done);
+}
+
+/*
+ * Is index_search_matches still indexing the search matches?
+ */
+public lbool indexing_matches(void)
+{
+	if (!index_matches || !prev_pattern(&search_info))
+		return (FALSE);
+	if ((ch_getflags() & (CH_CANSEEK|CH_HELPFILE)) != CH_CANSEEK)
+		return (FALSE);
+	check_match_index();
+	return (!match_index_complete());
+}
+
+/*
+ * Index the search matches in the next piece of the file
+ * (--index-matches).
+ * Return FALSE when there is nothing more to index.
+ */
+public lbool index_search_matches(void)
+{
+	if (!indexing_matches())
+		return (FALSE);
+	return (index_match_step());
+}
+
+/*
+ * Return the number of lines which match the search pattern,
+ * and set *pdone to whether the whole file has been searched.
+ * Return -1 if nothing has been searched.
+ */
+public LINENUM match_count(lbool *pdone)
+{
+	if (!prev_pattern(&search_info))
+		return (-1);
+	check_match_index();
+	if (match_index_pos == ch_zero() && !match_index_done)
+		return (-1);
+	if (pdone != NULL)
+		*pdone = match_index_complete();
+	return ((LINENUM) match_lines_count);
+}
+
+/*
+ * Return the number of indexed matching lines 
+ * which start before pos.
+ */
+static size_t matches_before(POSITION pos)
+{
+	size_t lo = 0;
+	size_t hi = match_lines_count;
+
+	while (lo < hi)
+	{
+		size_t mid = lo + (hi - lo) / 2;
+		if (match_lines[mid] < pos)
+			lo = mid + 1;
+		else
+			hi = mid;
+	}
+	return (lo);
+}
+
+/*
+ * Return the number of matching lines at or before 
+ * the line starting at pos, or -1 if that isn't known yet.
+ */
+public LINENUM match_number(POSITION pos)
+{
+	if (pos == NULL_POSITION || match_count(NULL) < 0)
+		return (-1);
+	if (pos >= match_index_pos && !match_index_complete())
+		return (-1);
+	return ((LINENUM) matches_before(pos + 1));
+}
+
+/*
+ * Use the match index to find the n-th matching line
+ * after (or before) pos, without reading the lines in between.
+ * Return FALSE if the index can't answer; otherwise set *pn
+ * the way search_range would set it.
+ */
+static lbool indexed_search(POSITION pos, int search_type, int *pn, POSITION *plinepos, POSITION *plastlinepos)
+{
+	size_t k;
+	size_t n = (size_t) *pn;
+	POSITION linepos;
+
+	if (!prev_pattern(&search_info) || *pn <= 0)
+		return (FALSE);
+	if ((search_type & (SRCH_NO_MATCH|SRCH_NO_REGEX)) != 
+	    (search_info.search_type & (SRCH_NO_MATCH|SRCH_NO_REGEX)))
+		return (FALSE);
+	/* Backward searches may match header lines, which are not indexed. */
+	if (nosearch_header_lines && header_lines > 0)
+		return (FALSE);
+	check_match_index();
+	if (get_cvt_ops(search_type) != match_index_cvt_ops)
+		return (FALSE);
+	k = matches_before(pos);
+	if (search_type & SRCH_FORW)
+	{
+		if (k + n > match_lines_count)
+		{
+			if ((search_type & SRCH_WRAP) || !match_index_complete())
+				return (FALSE);
+			*pn = (int) (k + n - match_lines_count);
+			return (TRUE);
+		}
+		linepos = match_lines[k + n - 1];
+	} else
+	{
+		if (pos > match_index_pos && !match_index_complete())
+			return (FALSE);
+		if (n > k)
+		{
+			if (search_type & SRCH_WRAP)
+				return (FALSE);
+			*pn = (int) (n - k);
+			return (TRUE);
+		}
+		linepos = match_lines[k - n];
+	}
+	/*
+	 * Search just the matching line, to highlight the match
+	 * and shift it into view as search_range does.
+	 */
+	search_type = (search_type & ~(SRCH_BACK|SRCH_WRAP)) | SRCH_FORW;
+	*pn = search_range(linepos, NULL_POSITION, search_type, 1, 1,
+			plinepos, (POSITION*)NULL, plastlinepos);
+	return (TRUE);
+}
+
+/*
+ * Return the position of the n-th line which matches the search pattern,
+ * searching the file as necessary, or NULL_POSITION if there are 
+ * not that many.
+ */
+static POSITION match_line_pos(LINENUM n)
+{
+	check_match_index();
+	while ((LINENUM) match_lines_count < n)
+	{
+		if (!index_match_step())
+			break;
+	}
+	if (n < 1 || (LINENUM) match_lines_count < n)
+		return (NULL_POSITION);
+	return (match_lines[n-1]);
+}
+
+/*
+ * Go to the n-th line which matches the search pattern.
+ */
+public void goto_match(LINENUM n)
+{
+	POSITION pos;
+	POSITION lastlinepos = NULL_POSITION;
+	int search_type;
+	PARG parg;
+
+	if (!prev_pattern(&search_info))
+	{
+		error("No previous regular expression", NULL_PARG);
+		return;
+	}
+	pos = match_line_pos(n);
+	if (pos == NULL_POSITION)
+	{
+		if (!ABORT_SIGS())
+		{
+			parg.p_linenum = match_count(NULL);
+			if (parg.p_linenum < 0)
+				parg.p_linenum = 0;
+			error("Only %n lines match", &parg);
+		}
+		return;
+	}
+	search_type = SRCH_FORW | (search_info.search_type & (SRCH_NO_MATCH|SRCH_NO_REGEX));
+	repeat_hilite();
+	if (search_range(pos, NULL_POSITION, search_type, 1, 1,
+			&pos, (POSITION*)NULL, &lastlinepos) == 0)
+	{
+		if (lastlinepos != NULL_POSITION)
+			jump_loc(lastlinepos, BOTTOM);
+		else
+			jump_loc(pos, jump_sline);
+	}
+	if (hilite_search == OPT_ON || status_col)
+		repaint_hilite(TRUE);
+}
 #endif
 
 #if HAVE_V8_REGCOMP
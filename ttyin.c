@@ -191,6 +191,7 @@ public int getchr(void)
 
 	do
 	{
+		flush_frame();
 		flush();
 #if MSDOS_COMPILER && MSDOS_COMPILER != DJGPPC
 		/*